@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include "Proc_stats.h"
+
+using namespace std;
+
+#define PSI_SAMPLE_INTERVAL_MS 500 // PSI averages move slowly; no need to re-read every tick
+#define MAX_LIVE_CHILDREN 64       // spawned but unfinished jobs allowed at once
+
+// Thresholds are "some avg10" stall percentages from /proc/pressure.
+// Above the throttle level no new job is started; above the shed level one
+// new start per PSI sample is rejected outright and the rest wait.
+struct AdmissionLimits
+{
+    double cpu_throttle_pct = 60.0, cpu_shed_pct = 95.0;
+    double memory_throttle_pct = 10.0, memory_shed_pct = 40.0;
+    double io_throttle_pct = 40.0, io_shed_pct = 90.0;
+    int max_live_children = MAX_LIVE_CHILDREN;
+};
+
+enum AdmissionDecision
+{
+    ADMIT = 0,
+    THROTTLE,
+    SHED
+};
+
+struct AdmissionControl
+{
+    AdmissionLimits limits;
+    PsiReading cpu, memory, io;
+    uint64_t last_sample_ms = 0;
+    uint64_t last_shed_sample_ms = 0; // sample that already shed a job
+    AdmissionDecision pressure = ADMIT; // verdict from the latest PSI sample
+    uint64_t throttled_checks = 0, shed_jobs = 0; // reported by print_admission_summary
+};
+
+static const char *admission_name(AdmissionDecision d)
+{
+    return d == ADMIT ? "admit" : (d == THROTTLE ? "throttle" : "shed");
+}
+
+static AdmissionDecision psi_verdict(const PsiReading &r, double throttle_pct, double shed_pct)
+{
+    if (!r.valid)
+        return ADMIT;
+    if (r.some_avg10 >= shed_pct)
+        return SHED;
+    if (r.some_avg10 >= throttle_pct)
+        return THROTTLE;
+    return ADMIT;
+}
+
+// Decides whether a queued job may be spawned now. Jobs already running are
+// never affected; only new starts are held back or rejected.
+inline AdmissionDecision admit_new_start(AdmissionControl &ac, int live_children, uint64_t now)
+{
+    if (ac.last_sample_ms == 0 || now - ac.last_sample_ms >= PSI_SAMPLE_INTERVAL_MS)
+    {
+        ac.last_sample_ms = now;
+        ac.cpu = read_psi("cpu");
+        ac.memory = read_psi("memory");
+        ac.io = read_psi("io");
+
+        const AdmissionLimits &l = ac.limits;
+        AdmissionDecision d = max(psi_verdict(ac.cpu, l.cpu_throttle_pct, l.cpu_shed_pct),
+                                  max(psi_verdict(ac.memory, l.memory_throttle_pct, l.memory_shed_pct),
+                                      psi_verdict(ac.io, l.io_throttle_pct, l.io_shed_pct)));
+        if (d != ac.pressure)
+        {
+            cout << "Admission at " << now << ": " << admission_name(d)
+                 << " (cpu=" << ac.cpu.some_avg10 << "% memory=" << ac.memory.some_avg10
+                 << "% io=" << ac.io.some_avg10 << "%)\n";
+            ac.pressure = d;
+        }
+    }
+
+    AdmissionDecision d = ac.pressure;
+    // The verdict is cached for a whole sample; shedding on every call would
+    // reject the entire backlog in one pass. Shed once, then hold the rest.
+    if (d == SHED)
+    {
+        if (ac.last_shed_sample_ms == ac.last_sample_ms)
+            d = THROTTLE;
+        else
+            ac.last_shed_sample_ms = ac.last_sample_ms;
+    }
+    if (d == ADMIT && live_children >= ac.limits.max_live_children)
+        d = THROTTLE;
+    if (d == THROTTLE)
+        ac.throttled_checks++;
+    return d;
+}
+
+// End-of-run summary of how often admission held back or rejected work.
+inline void print_admission_summary(const AdmissionControl &ac, const char *policy)
+{
+    cout << policy << " admission: " << ac.throttled_checks << " throttled admission check(s), "
+         << ac.shed_jobs << " job(s) shed\n";
+}
@@ -0,0 +1,346 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <algorithm>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "Job_table.h"
+
+using namespace std;
+
+// Scheduler state in one memory-mapped file:
+//
+//     header | jobs[job_capacity] | histories[history_capacity] | edges[edge_capacity] | arena bytes
+//
+// Records are only written when they differ from the mapped copy, so each
+// checkpoint dirties (and msyncs) just the pages that changed. Edges and
+// command strings are append-only. Writes land in the page cache as they
+// happen, so a scheduler that dies between checkpoints loses at most the
+// last interval, not the file.
+
+#define CHECKPOINT_MAGIC 0x314b504348435300ULL // "\0SCHCKP1"
+#define CHECKPOINT_VERSION 3
+#define CHECKPOINT_INTERVAL_MS 1000
+#define CHECKPOINT_CLEAN 1 // scheduler exited with every job finished
+
+struct CheckpointHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t history_record_size; // sizeof(CmdHistory) of the writer
+    uint64_t generation;          // bumped by every checkpoint
+    uint32_t flags;
+    uint32_t in_progress;         // 1 while records are being updated
+    int64_t start_sec, start_nsec; // scheduler time origin (CLOCK_MONOTONIC)
+    uint64_t saved_ms;
+    uint32_t job_count, job_capacity;
+    uint32_t history_count, history_capacity;
+    uint32_t edge_count, edge_capacity;
+    uint64_t arena_bytes, arena_capacity;
+    uint64_t jobs_off, histories_off, edges_off, arena_off, file_size;
+};
+
+struct CheckpointJob
+{
+    int32_t pid;
+    uint8_t state;
+    int8_t level;
+    uint16_t reserved;
+    int32_t history_index;
+    uint32_t total_cpu_ms;
+    float weight;
+    uint64_t proc_start; // /proc starttime of pid, guards against pid reuse
+    JobMetrics metrics;
+};
+
+struct CheckpointEdge
+{
+    uint32_t parent, child;
+};
+
+struct CheckpointFile
+{
+    int fd = -1;
+    char *map = nullptr;
+    size_t size = 0;
+    string path;
+};
+
+inline CheckpointHeader *checkpoint_header(const CheckpointFile &cf)
+{
+    return reinterpret_cast<CheckpointHeader *>(cf.map);
+}
+
+inline CheckpointJob *checkpoint_jobs(const CheckpointFile &cf)
+{
+    return reinterpret_cast<CheckpointJob *>(cf.map + checkpoint_header(cf)->jobs_off);
+}
+
+inline char *checkpoint_histories(const CheckpointFile &cf)
+{
+    return cf.map + checkpoint_header(cf)->histories_off;
+}
+
+inline CheckpointEdge *checkpoint_edges(const CheckpointFile &cf)
+{
+    return reinterpret_cast<CheckpointEdge *>(cf.map + checkpoint_header(cf)->edges_off);
+}
+
+inline char *checkpoint_arena(const CheckpointFile &cf)
+{
+    return cf.map + checkpoint_header(cf)->arena_off;
+}
+
+// Opens (or creates) the file and maps whatever it holds.
+inline bool open_checkpoint(CheckpointFile &cf, const string &path)
+{
+    cf.fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (cf.fd == -1)
+    {
+        cerr << "Could not open checkpoint " << path << "\n";
+        return false;
+    }
+    cf.path = path;
+    struct stat st;
+    if (fstat(cf.fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(CheckpointHeader))
+    {
+        void *m = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, cf.fd, 0);
+        if (m != MAP_FAILED)
+        {
+            cf.map = static_cast<char *>(m);
+            cf.size = static_cast<size_t>(st.st_size);
+        }
+    }
+    return true;
+}
+
+inline void close_checkpoint(CheckpointFile &cf)
+{
+    if (cf.map)
+    {
+        msync(cf.map, cf.size, MS_SYNC);
+        munmap(cf.map, cf.size);
+    }
+    if (cf.fd >= 0)
+        close(cf.fd);
+    cf = CheckpointFile();
+}
+
+// Header written by this build, with sections that fit the file.
+inline bool checkpoint_valid(const CheckpointFile &cf, uint32_t history_record_size)
+{
+    if (!cf.map || cf.size < sizeof(CheckpointHeader))
+        return false;
+    const CheckpointHeader *h = checkpoint_header(cf);
+    return h->magic == CHECKPOINT_MAGIC && h->version == CHECKPOINT_VERSION &&
+           h->history_record_size == history_record_size && h->file_size <= cf.size &&
+           h->job_count <= h->job_capacity && h->history_count <= h->history_capacity &&
+           h->edge_count <= h->edge_capacity && h->arena_bytes <= h->arena_capacity &&
+           h->jobs_off >= sizeof(CheckpointHeader) &&
+           h->histories_off == h->jobs_off + static_cast<uint64_t>(h->job_capacity) * sizeof(CheckpointJob) &&
+           h->edges_off == h->histories_off + static_cast<uint64_t>(h->history_capacity) * history_record_size &&
+           h->arena_off == h->edges_off + static_cast<uint64_t>(h->edge_capacity) * sizeof(CheckpointEdge) &&
+           h->file_size == h->arena_off + h->arena_capacity;
+}
+
+// Records that restore would index with: every job's command and level,
+// and every edge's jobs, must exist. Returns what is wrong, or nullptr.
+inline const char *checkpoint_records_invalid(const CheckpointFile &cf)
+{
+    const CheckpointHeader *h = checkpoint_header(cf);
+    const char *arena = checkpoint_arena(cf);
+    uint64_t strings = 0;
+    for (uint64_t i = 0; i < h->arena_bytes && strings < h->history_count; ++i)
+        strings += arena[i] == '\0';
+    if (strings < h->history_count)
+        return "fewer commands than histories";
+    const CheckpointJob *jobs = checkpoint_jobs(cf);
+    for (uint32_t i = 0; i < h->job_count; ++i)
+    {
+        const CheckpointJob &j = jobs[i];
+        if (j.history_index < 0 || static_cast<uint32_t>(j.history_index) >= h->history_count)
+            return "job with an unknown command";
+        if (j.level < -1 || j.level > 2 || (j.state & ~0x1f) != 0)
+            return "job with a bad state or level";
+    }
+    const CheckpointEdge *edges = checkpoint_edges(cf);
+    for (uint32_t i = 0; i < h->edge_count; ++i)
+        if (edges[i].parent >= edges[i].child || edges[i].child >= h->job_count)
+            return "dependency on an unknown job";
+    return nullptr;
+}
+
+static uint64_t grow_capacity(uint64_t have, uint64_t need, uint64_t floor)
+{
+    uint64_t cap = max(have, floor);
+    while (cap < need)
+        cap *= 2;
+    return cap;
+}
+
+// Makes room for the given counts. Sections keep their order and only move
+// towards the end, so they are shifted in place from the last one back.
+inline bool reserve_checkpoint(CheckpointFile &cf, uint32_t jobs, uint32_t histories, uint32_t edges,
+                               uint64_t arena_bytes, uint32_t history_record_size)
+{
+    CheckpointHeader old = {};
+    bool fresh = !checkpoint_valid(cf, history_record_size);
+    if (!fresh)
+    {
+        old = *checkpoint_header(cf);
+        if (jobs <= old.job_capacity && histories <= old.history_capacity &&
+            edges <= old.edge_capacity && arena_bytes <= old.arena_capacity)
+            return true;
+    }
+
+    if (fresh && cf.map)
+    {
+        // Unknown or stale layout: start from an empty file.
+        munmap(cf.map, cf.size);
+        cf.map = nullptr;
+        cf.size = 0;
+        if (ftruncate(cf.fd, 0) == -1)
+            return false;
+    }
+
+    CheckpointHeader h = old;
+    h.job_capacity = static_cast<uint32_t>(grow_capacity(old.job_capacity, jobs, 256));
+    h.history_capacity = static_cast<uint32_t>(grow_capacity(old.history_capacity, histories, 64));
+    h.edge_capacity = static_cast<uint32_t>(grow_capacity(old.edge_capacity, edges, 64));
+    h.arena_capacity = grow_capacity(old.arena_capacity, arena_bytes, 4096);
+    h.jobs_off = (sizeof(CheckpointHeader) + 63) & ~63ULL;
+    h.histories_off = h.jobs_off + h.job_capacity * sizeof(CheckpointJob);
+    h.edges_off = h.histories_off + static_cast<uint64_t>(h.history_capacity) * history_record_size;
+    h.arena_off = h.edges_off + h.edge_capacity * sizeof(CheckpointEdge);
+    h.file_size = h.arena_off + h.arena_capacity;
+
+    if (ftruncate(cf.fd, static_cast<off_t>(h.file_size)) == -1)
+        return false;
+    void *m = cf.map ? mremap(cf.map, cf.size, h.file_size, MREMAP_MAYMOVE)
+                     : mmap(nullptr, h.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, cf.fd, 0);
+    if (m == MAP_FAILED)
+    {
+        cf.map = nullptr;
+        return false;
+    }
+    cf.map = static_cast<char *>(m);
+    cf.size = h.file_size;
+
+    if (fresh)
+    {
+        memset(cf.map, 0, h.jobs_off);
+        h.magic = CHECKPOINT_MAGIC;
+        h.version = CHECKPOINT_VERSION;
+        h.history_record_size = history_record_size;
+    }
+    else
+    {
+        memmove(cf.map + h.arena_off, cf.map + old.arena_off, old.arena_bytes);
+        memmove(cf.map + h.edges_off, cf.map + old.edges_off, old.edge_count * sizeof(CheckpointEdge));
+        memmove(cf.map + h.histories_off, cf.map + old.histories_off,
+                static_cast<uint64_t>(old.history_count) * history_record_size);
+        // Clear what the shifted sections left behind past their contents.
+        auto clear_gap = [&](uint64_t from, uint64_t to) {
+            if (to > from)
+                memset(cf.map + from, 0, to - from);
+        };
+        clear_gap(h.jobs_off + old.job_count * sizeof(CheckpointJob), h.histories_off);
+        clear_gap(h.histories_off + static_cast<uint64_t>(old.history_count) * history_record_size, h.edges_off);
+        clear_gap(h.edges_off + old.edge_count * sizeof(CheckpointEdge), h.arena_off);
+        clear_gap(h.arena_off + old.arena_bytes, h.file_size);
+    }
+    *checkpoint_header(cf) = h;
+    return true;
+}
+
+// Copies n bytes over the mapped copy only if they differ. Returns true if written.
+inline bool update_checkpoint_bytes(void *slot, const void *src, size_t n)
+{
+    if (memcmp(slot, src, n) == 0)
+        return false;
+    memcpy(slot, src, n);
+    return true;
+}
+
+inline void sync_checkpoint(const CheckpointFile &cf)
+{
+    if (cf.map)
+        msync(cf.map, cf.size, MS_ASYNC);
+}
+
+// Process state letter and start time (clock ticks since boot) from
+// /proc/<pid>/stat; false if the process is gone.
+inline bool read_proc_state(pid_t pid, char &state, uint64_t &start_time)
+{
+    char path[64], buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", static_cast<int>(pid));
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return false;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+    char *rest = strrchr(buf, ')');
+    if (!rest || rest[1] == '\0')
+        return false;
+    state = rest[2];
+    int field = 3;
+    for (char *tok = strtok(rest + 2, " "); tok; tok = strtok(nullptr, " "), ++field)
+        if (field == 22)
+        {
+            start_time = strtoull(tok, nullptr, 10);
+            return true;
+        }
+    return false;
+}
+
+// The checkpoint record of job h, written in place when it changed.
+inline void write_checkpoint_job(CheckpointFile &cf, const JobTable &jobs, JobHandle h)
+{
+    CheckpointJob &slot = checkpoint_jobs(cf)[h];
+    CheckpointJob rec;
+    memset(static_cast<void *>(&rec), 0, sizeof(rec));
+    rec.pid = jobs.pid[h];
+    rec.state = jobs.state[h];
+    rec.level = jobs.level[h];
+    rec.history_index = jobs.history_index[h];
+    rec.total_cpu_ms = jobs.total_cpu_ms[h];
+    rec.weight = jobs.weight[h];
+    rec.metrics = jobs.metrics[h];
+    rec.proc_start = slot.proc_start;
+    if (rec.pid > 0 && rec.pid != slot.pid)
+    {
+        char state;
+        if (!read_proc_state(rec.pid, state, rec.proc_start))
+            rec.proc_start = 0;
+    }
+    update_checkpoint_bytes(&slot, &rec, sizeof(rec));
+}
+
+// pidfd for a process we did not fork; -1 where the kernel lacks pidfd_open.
+inline int open_pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// A pidfd polls readable once its process has exited.
+inline bool pidfd_exited(int pidfd)
+{
+    struct pollfd p = {pidfd, POLLIN, 0};
+    return poll(&p, 1, 0) > 0;
+}
@@ -0,0 +1,249 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <sys/types.h>
+#include "Proc_stats.h"
+#include "Output_capture.h"
+
+using namespace std;
+
+typedef uint32_t JobHandle;
+
+enum JobStateBits : uint8_t
+{
+    JOB_STARTED = 1,
+    JOB_FINISHED = 2,
+    JOB_ERROR = 4,
+    JOB_BLOCKED = 8, // waiting for dependencies to finish
+    JOB_IO_WAIT = 16 // blocked mid-slice, left running outside the MLFQ queues
+};
+
+// Every distinct command string is stored once, NUL-terminated, in one
+// contiguous buffer. Ids are dense and handed out in first-seen order, so the
+// id of a command is also the index of its CmdHistory entry.
+class CommandArena
+{
+public:
+    // Id of the string, adding it on first sight.
+    uint32_t intern(const char *s, size_t len)
+    {
+        if ((offsets.size() + 1) * 2 > slots.size())
+            rehash(slots.empty() ? 64 : slots.size() * 2);
+        uint32_t hash = hash_bytes(s, len);
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            uint32_t slot = slots[i];
+            if (slot == 0)
+            {
+                uint32_t id = static_cast<uint32_t>(offsets.size());
+                offsets.push_back(static_cast<uint32_t>(bytes.size()));
+                hashes.push_back(hash);
+                bytes.insert(bytes.end(), s, s + len);
+                bytes.push_back('\0');
+                slots[i] = id + 1;
+                return id;
+            }
+            if (hashes[slot - 1] == hash && matches(slot - 1, s, len))
+                return slot - 1;
+        }
+    }
+
+    uint32_t intern(const string &s)
+    {
+        return intern(s.data(), s.size());
+    }
+
+    // Id of the string, or -1 if it was never interned.
+    int find(const char *s, size_t len) const
+    {
+        if (slots.empty())
+            return -1;
+        uint32_t hash = hash_bytes(s, len);
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            uint32_t slot = slots[i];
+            if (slot == 0)
+                return -1;
+            if (hashes[slot - 1] == hash && matches(slot - 1, s, len))
+                return static_cast<int>(slot - 1);
+        }
+    }
+
+    // Valid until the next intern() call.
+    const char *c_str(uint32_t id) const
+    {
+        return bytes.data() + offsets[id];
+    }
+
+    size_t length(uint32_t id) const
+    {
+        size_t end = (id + 1 < offsets.size()) ? offsets[id + 1] : bytes.size();
+        return end - offsets[id] - 1;
+    }
+
+    size_t size() const
+    {
+        return offsets.size();
+    }
+
+private:
+    vector<char> bytes;
+    vector<uint32_t> offsets;
+    vector<uint32_t> hashes;
+    vector<uint32_t> slots; // open addressing, id + 1 (0 = empty)
+
+    static uint32_t hash_bytes(const char *s, size_t len)
+    {
+        uint32_t h = 2166136261u; // FNV-1a
+        for (size_t i = 0; i < len; ++i)
+        {
+            h ^= static_cast<unsigned char>(s[i]);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    bool matches(uint32_t id, const char *s, size_t len) const
+    {
+        return length(id) == len && memcmp(bytes.data() + offsets[id], s, len) == 0;
+    }
+
+    void rehash(size_t capacity)
+    {
+        slots.assign(capacity, 0);
+        size_t mask = capacity - 1;
+        for (uint32_t id = 0; id < offsets.size(); ++id)
+        {
+            size_t i = hashes[id] & mask;
+            while (slots[i] != 0)
+                i = (i + 1) & mask;
+            slots[i] = id + 1;
+        }
+    }
+};
+
+// Per-job timings in ms since scheduler start; only touched when a job
+// starts, finishes or is exported.
+struct JobMetrics
+{
+    uint32_t arrival_time = 0, completion_time = 0, turnaround_time = 0,
+             waiting_time = 0, response_time = 0, slice_start_ms = 0;
+    uint64_t output_bytes = 0;
+    uint32_t splice_us = 0;   // scheduler time spent moving the job's output
+    uint32_t deadline_ms = 0; // turnaround target, 0 = none
+};
+
+// State only a spawned, unfinished job needs. Kept in a recycled pool so
+// queued descriptors do not carry it.
+struct JobRuntime
+{
+    ProcSample slice_sample, last_sample; // /proc counters at slice start and latest tick
+    JobClass job_class = JOB_UNKNOWN;     // behaviour seen in the last full window
+    int kernel_level = -1;                // KernelPrioLevel last applied, -1 for none
+    OutputCapture output;                 // stdout+stderr pipe, unused when capture is off
+    int io_wait_level = -1;               // MLFQ level to rejoin once a JOB_IO_WAIT job can run
+    // Set for jobs re-adopted from a checkpoint: another process is their
+    // parent, so exit is seen through the pidfd instead of waitpid.
+    bool adopted = false;
+    int pidfd = -1;
+    uint64_t proc_start = 0;              // /proc starttime, when no pidfd is available
+    uint64_t exit_seen_ms = 0;            // when the adopted job was first seen gone
+};
+
+// Dependency edges of a job. Only jobs that have dependencies or dependents
+// get a node, so independent jobs pay nothing for the DAG.
+struct DagNode
+{
+    vector<JobHandle> parents;
+    vector<JobHandle> children;
+    uint32_t pending = 0;         // parents not finished yet
+    double est_ms = 0.0;          // predicted burst of the job itself
+    double downstream_ms = 0.0;   // longest predicted chain of work waiting on it
+};
+
+// Job table as columns indexed by JobHandle. The hot columns are what the
+// SJF/MLFQ selection and placement loops scan; everything else lives in
+// cold metrics or the runtime pool.
+struct JobTable
+{
+    // hot
+    vector<pid_t> pid;             // -1 until spawned
+    vector<uint8_t> state;         // JobStateBits
+    vector<int8_t> level;          // MLFQ queue the job waits in, -1 when not queued
+    vector<int32_t> history_index; // CmdHistory / CommandArena id
+    vector<uint32_t> total_cpu_ms;
+    vector<float> weight;          // priority scale from the submission, 1 = normal
+    vector<int32_t> runtime_slot;  // index into runtime_pool, -1 when none
+
+    // cold
+    vector<JobMetrics> metrics;
+    vector<JobRuntime> runtime_pool;
+    vector<int32_t> free_runtime_slots;
+    unordered_map<JobHandle, DagNode> dag;
+
+    uint32_t size() const
+    {
+        return static_cast<uint32_t>(pid.size());
+    }
+
+    JobHandle add(int32_t hist_idx, uint32_t arrival)
+    {
+        JobHandle h = size();
+        pid.push_back(-1);
+        state.push_back(0);
+        level.push_back(-1);
+        history_index.push_back(hist_idx);
+        total_cpu_ms.push_back(0);
+        weight.push_back(1.0f);
+        runtime_slot.push_back(-1);
+        metrics.emplace_back();
+        metrics.back().arrival_time = arrival;
+        return h;
+    }
+
+    bool started(JobHandle h) const { return state[h] & JOB_STARTED; }
+    bool finished(JobHandle h) const { return state[h] & JOB_FINISHED; }
+    bool error(JobHandle h) const { return state[h] & JOB_ERROR; }
+
+    void set_state(JobHandle h, uint8_t bit, bool on)
+    {
+        if (on)
+            state[h] |= bit;
+        else
+            state[h] &= static_cast<uint8_t>(~bit);
+    }
+
+    // Runtime state of a job, taking a pool slot on first use. References
+    // stay valid until another job acquires a slot.
+    JobRuntime &runtime(JobHandle h)
+    {
+        if (runtime_slot[h] < 0)
+        {
+            if (free_runtime_slots.empty())
+            {
+                runtime_slot[h] = static_cast<int32_t>(runtime_pool.size());
+                runtime_pool.emplace_back();
+            }
+            else
+            {
+                runtime_slot[h] = free_runtime_slots.back();
+                free_runtime_slots.pop_back();
+                runtime_pool[runtime_slot[h]] = JobRuntime();
+            }
+        }
+        return runtime_pool[runtime_slot[h]];
+    }
+
+    void release_runtime(JobHandle h)
+    {
+        if (runtime_slot[h] < 0)
+            return;
+        free_runtime_slots.push_back(runtime_slot[h]);
+        runtime_slot[h] = -1;
+    }
+};
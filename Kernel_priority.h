@@ -0,0 +1,174 @@
+#pragma once
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include "Proc_stats.h"
+
+using namespace std;
+
+#define SCHEDULER_NICE -10    // the dispatcher itself must not be starved by its jobs
+#define SJF_SHORT_JOB_MS 100  // SJF estimates below this get q0's kernel class
+#define SJF_LONG_JOB_MS 2000  // and above this q2's
+
+// Kernel-side classes the userspace levels map onto, highest first.
+enum KernelPrioLevel
+{
+    KPRIO_Q0 = 0,
+    KPRIO_Q1,
+    KPRIO_Q2,
+    KPRIO_BACKGROUND, // CPU hogs parked at the bottom level
+    KPRIO_LEVELS
+};
+
+struct KernelPriority
+{
+    int policy;
+    int nice;
+};
+
+static const KernelPriority kernel_priority_map[KPRIO_LEVELS] = {
+    {SCHED_OTHER, -5},
+    {SCHED_OTHER, 0},
+    {SCHED_BATCH, 10},
+    {SCHED_IDLE, 19},
+};
+
+// nice values below this cannot be restored once a job was moved above it:
+// anything goes with CAP_SYS_NICE, otherwise RLIMIT_NICE allows down to
+// 20 - rlim_cur (and 0 allows nothing, reported as 20).
+static int lowest_reversible_nice()
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f)
+    {
+        char line[256];
+        unsigned long long caps = 0;
+        while (fgets(line, sizeof(line), f))
+            if (sscanf(line, "CapEff: %llx", &caps) == 1)
+                break;
+        fclose(f);
+        if (caps & (1ULL << 23)) // CAP_SYS_NICE
+            return -20;
+    }
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NICE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+        return 20 - static_cast<int>(min<rlim_t>(rl.rlim_cur, 40));
+    return -20;
+}
+
+// kernel_priority_map cut down to what can be undone. Demoting a job is
+// only useful if a later boost can promote it again, so without the rights
+// to lower nice back to 0 jobs keep nice 0, and SCHED_IDLE becomes
+// SCHED_BATCH: leaving it needs RLIMIT_NICE to allow the job's current nice,
+// which at nice 0 is exactly what is missing.
+struct EffectivePriorityMap
+{
+    KernelPriority level[KPRIO_LEVELS];
+    bool set_nice = true;
+};
+
+static const EffectivePriorityMap &effective_priority_map()
+{
+    static EffectivePriorityMap m = []() {
+        EffectivePriorityMap e;
+        int lo = lowest_reversible_nice();
+        e.set_nice = lo <= 0;
+        for (int i = 0; i < KPRIO_LEVELS; ++i)
+        {
+            e.level[i] = kernel_priority_map[i];
+            e.level[i].nice = e.set_nice ? max(e.level[i].nice, lo) : 0;
+            if (e.level[i].policy == SCHED_IDLE && !e.set_nice)
+                e.level[i].policy = SCHED_BATCH;
+        }
+        if (lo > -5)
+            cerr << "Kernel priority: no CAP_SYS_NICE and RLIMIT_NICE only allows nice >= " << lo << "; "
+                 << (e.set_nice ? "q0 jobs get that instead of -5"
+                                : "job nice values are left alone so demotions stay reversible")
+                 << "\n";
+        return e;
+    }();
+    return m;
+}
+
+// Sets the policy on every thread of pid and, recursively, of the processes
+// it forked. Returns false only if pid's own threads refused; descendants
+// that exit in between are skipped.
+static bool set_tree_scheduler(pid_t pid, int policy, int depth = 0)
+{
+    struct sched_param param;
+    param.sched_priority = 0;
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task", static_cast<int>(pid));
+    bool ok = true;
+    if (DIR *d = opendir(path))
+    {
+        while (struct dirent *ent = readdir(d))
+        {
+            pid_t tid = static_cast<pid_t>(atoi(ent->d_name));
+            if (tid > 0 && sched_setscheduler(tid, policy, &param) == -1 && errno != ESRCH)
+                ok = false;
+        }
+        closedir(d);
+    }
+    else if (sched_setscheduler(pid, policy, &param) == -1)
+        ok = false;
+
+    vector<int> children;
+    if (depth < 8 && read_proc_children(pid, children))
+        for (int c : children)
+            set_tree_scheduler(c, policy, depth + 1);
+    return ok || depth > 0;
+}
+
+// Moves a job onto the policy/nice of the given level. The job pid is the
+// `sh -c` wrapper, so the policy (which is per task) is set on its whole
+// process tree, and nice on its process group. Later forks inherit both.
+// Returns false if any part was refused; the caller should try again later.
+inline bool apply_kernel_priority(pid_t pid, int level)
+{
+    static bool warned = false;
+    if (pid <= 0 || level < 0 || level >= KPRIO_LEVELS)
+        return false;
+    const EffectivePriorityMap &map = effective_priority_map();
+    const KernelPriority &kp = map.level[level];
+    const char *failed = nullptr;
+    if (!set_tree_scheduler(pid, kp.policy))
+        failed = "sched_setscheduler";
+    else if (map.set_nice && setpriority(PRIO_PGRP, pid, kp.nice) == -1)
+        failed = "setpriority";
+    if (failed && !warned)
+    {
+        warned = true;
+        cerr << "Kernel priority: " << failed << " for job " << pid << " failed (" << strerror(errno)
+             << "), will retry on its next dispatch\n";
+    }
+    return failed == nullptr;
+}
+
+inline void raise_scheduler_priority()
+{
+    static bool warned = false;
+    if (setpriority(PRIO_PROCESS, 0, SCHEDULER_NICE) == -1 && !warned)
+    {
+        warned = true;
+        cerr << "Kernel priority: raising the scheduler's priority failed (" << strerror(errno)
+             << "), it runs at its current nice\n";
+    }
+}
+
+inline int sjf_kernel_level(double est_ms)
+{
+    if (est_ms < SJF_SHORT_JOB_MS)
+        return KPRIO_Q0;
+    if (est_ms > SJF_LONG_JOB_MS)
+        return KPRIO_Q2;
+    return KPRIO_Q1;
+}
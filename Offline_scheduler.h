@@ -108,7 +108,7 @@ inline void FCFS(vector<Process> &processes)
     write_results_to_csv(processes, "result_offline_FCFS.csv");
 }
 
-void RoundRobin(vector<Process> &processes, int quantum_ms)
+inline void RoundRobin(vector<Process> &processes, int quantum_ms)
 {
     auto scheduler_start = get_current_time_ms();
     vector<uint64_t> total_cpu_times(processes.size(), 0);
@@ -174,7 +174,7 @@ void RoundRobin(vector<Process> &processes, int quantum_ms)
     write_results_to_csv(processes, "result_offline_RR.csv");
 }
 
-void MultiLevelFeedbackQueue(vector<Process>& processes, int quantum0, int quantum1, int quantum2, int boostTime) {
+inline void MultiLevelFeedbackQueue(vector<Process>& processes, int quantum0, int quantum1, int quantum2, int boostTime) {
     
     uint64_t scheduler_start = get_current_time_ms();
     uint64_t last_boost_time = scheduler_start;
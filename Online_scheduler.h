@@ -9,6 +9,7 @@
 #include <fstream>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/select.h>
 #include <thread>
 #include <chrono>
@@ -17,6 +18,15 @@
 #include <cerrno>
 #include <functional>
 #include <algorithm>
+#include "Quantum_tuner.h"
+#include "Proc_stats.h"
+#include "Admission_control.h"
+#include "Kernel_priority.h"
+#include "Output_capture.h"
+#include "Job_table.h"
+#include "Trace_replay.h"
+#include "Checkpoint.h"
+#include "Supervisor.h"
 
 using namespace std;
 
@@ -25,27 +35,29 @@ using namespace std;
 #define MAX_HISTORY 50
 #define POLL_SLEEP_MS 20   // ms poll granularity
 #define MAX_UNIQUE_CMDS 200
-
-static queue<int> q0arr, q1arr, q2arr;
-
+#define DEFAULT_BURST_ESTIMATE_MS 1000.0 // prediction for commands without history
+#define CRITICAL_PATH_WEIGHT 0.5         // share of downstream DAG work credited as priority
+#define NO_JOB static_cast<JobHandle>(-1) // enqueue_command rejected the submission
+#define ADOPTED_EXIT_GRACE_MS 1000       // wait this long for the supervisor to report an adopted job's exit
+
+static queue<JobHandle> q0arr, q1arr, q2arr;
+static int completion_fd = -1; // finished jobs are reported here when >= 0
+static string completion_backlog; // report lines the fd could not take yet
+static CheckpointFile *job_checkpoint = nullptr; // spawns and exits update their record at once
+static string orphan_exits_file;                 // exit statuses of adopted jobs, from the supervisor
+static volatile sig_atomic_t handoff_requested = 0;
+
+// Indexed by CommandArena id; the command text lives in the arena.
 struct CmdHistory
 {
-    string cmd;
-    vector<double> bursts = vector<double>(MAX_HISTORY, 0.0);
+    double bursts[MAX_HISTORY] = {};
     int count = 0;
     int next_idx = 0;
-};
-
-struct OnlineProcess
-{
-    string command;
-    bool finished = false, error = false, started = false;
-    pid_t pid = -1;
-    uint64_t arrival_time = 0, completion_time = 0, turnaround_time = 0,
-             waiting_time = 0, response_time = 0, total_cpu_time = 0;
-    int history_index = -1;
-    bool csv_written = false;
-    uint64_t slice_start_ms = 0;
+    // Behaviour sampled from /proc while jobs of this command ran (EWMA).
+    double cpu_ratio = 0.0;
+    double voluntary_share = 0.0;
+    uint64_t blkio_ms = 0;
+    int behavior_samples = 0;
 };
 
 static struct timespec program_start_ts;
@@ -63,6 +75,14 @@ static uint64_t now_ms() {
     return (uint64_t)(sec_diff * 1000LL + ns_diff / 1000000LL);
 }
 
+static uint64_t now_us() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    int64_t sec_diff = (int64_t)t.tv_sec - (int64_t)program_start_ts.tv_sec;
+    int64_t ns_diff = (int64_t)t.tv_nsec - (int64_t)program_start_ts.tv_nsec;
+    return (uint64_t)(sec_diff * 1000000LL + ns_diff / 1000LL);
+}
+
 static void record_burst_to_history(vector<CmdHistory> &cmd_history, int hist_idx, double burst_ms)
 {
     if (hist_idx < 0 || hist_idx >= static_cast<int>(cmd_history.size()))
@@ -92,6 +112,50 @@ static double get_avg_burst_ms(const vector<CmdHistory> &cmd_history, int hist_i
     return sum / static_cast<double>(to_take);
 }
 
+static void record_behavior_to_history(vector<CmdHistory> &cmd_history, int hist_idx, const ProcBehavior &b)
+{
+    if (!b.valid || hist_idx < 0 || hist_idx >= static_cast<int>(cmd_history.size()))
+        return;
+    CmdHistory &h = cmd_history[hist_idx];
+    if (h.behavior_samples == 0)
+    {
+        h.cpu_ratio = b.cpu_ratio;
+        h.voluntary_share = b.voluntary_share;
+    }
+    else
+    {
+        h.cpu_ratio = 0.7 * h.cpu_ratio + 0.3 * b.cpu_ratio;
+        h.voluntary_share = 0.7 * h.voluntary_share + 0.3 * b.voluntary_share;
+    }
+    h.blkio_ms += b.blkio_ms;
+    h.behavior_samples++;
+}
+
+static JobClass get_history_class(const vector<CmdHistory> &cmd_history, int hist_idx)
+{
+    if (hist_idx < 0 || hist_idx >= static_cast<int>(cmd_history.size()))
+        return JOB_UNKNOWN;
+    const CmdHistory &h = cmd_history[hist_idx];
+    if (h.behavior_samples == 0)
+        return JOB_UNKNOWN;
+    return classify_behavior(h.cpu_ratio, h.voluntary_share, h.blkio_ms);
+}
+
+static void collect_recent_bursts(const vector<CmdHistory> &cmd_history, int k, vector<double> &out)
+{
+    out.clear();
+    for (const auto &h : cmd_history)
+    {
+        int to_take = (k <= 0) ? h.count : min(h.count, k);
+        int idx = (h.next_idx - 1 + MAX_HISTORY) % MAX_HISTORY;
+        for (int i = 0; i < to_take; ++i)
+        {
+            out.push_back(h.bursts[idx]);
+            idx = (idx - 1 + MAX_HISTORY) % MAX_HISTORY;
+        }
+    }
+}
+
 inline void set_stdin_nonblocking(bool enable)
 {
     int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
@@ -104,39 +168,261 @@ inline void set_stdin_nonblocking(bool enable)
     fcntl(STDIN_FILENO, F_SETFL, flags);
 }
 
-inline int find_history_index(const vector<CmdHistory> &ch, const string &cmd)
+inline int find_history_index(const CommandArena &arena, const string &cmd)
 {
-    for (int i = 0; i < static_cast<int>(ch.size()); ++i)
-        if (ch[i].cmd == cmd)
-            return i;
-    return -1;
+    return arena.find(cmd.data(), cmd.size());
 }
 
-inline int ensure_history_index(vector<CmdHistory> &ch, const string &cmd)
+inline int ensure_history_index(CommandArena &arena, vector<CmdHistory> &ch, const char *cmd, size_t len)
 {
-    int idx = find_history_index(ch, cmd);
-    if (idx >= 0)
-        return idx;
-    CmdHistory newEntry;
-    newEntry.cmd = cmd;
-    ch.push_back(newEntry);
-    return static_cast<int>(ch.size()) - 1;
+    uint32_t id = arena.intern(cmd, len);
+    if (id >= ch.size())
+        ch.resize(id + 1);
+    return static_cast<int>(id);
 }
 
-inline void spawn_and_stop_child(OnlineProcess &p)
+// output_path empty: the job shares the scheduler's stdout/stderr.
+inline void spawn_and_stop_child(JobTable &jobs, JobHandle h, const char *command, const string &output_path = "")
 {
+    OutputCapture &output = jobs.runtime(h).output;
+    if (!output_path.empty())
+        open_output_capture(output, output_path, job_checkpoint != nullptr);
     pid_t pid = fork();
     if (pid == 0)
     {
         setpgid(0, 0);
+        // Do not inherit the dispatcher's raised priority.
+        setpriority(PRIO_PROCESS, 0, 0);
+        // stdin carries the scheduler's own submissions; jobs must not eat them.
+        int devnull = open("/dev/null", O_RDONLY);
+        if (devnull > STDIN_FILENO)
+        {
+            dup2(devnull, STDIN_FILENO);
+            close(devnull);
+        }
+        attach_output_capture(output);
+#ifdef SYS_close_range
+        // Nor inherit anything else, e.g. the result CSV streams.
+        syscall(SYS_close_range, 3U, ~0U, 0U);
+#endif
         raise(SIGSTOP);
-        execl("/bin/sh", "sh", "-c", p.command.c_str(), (char *)NULL);
+        execl("/bin/sh", "sh", "-c", command, (char *)NULL);
         _exit(127);
     }
     else
     {
-        p.pid = pid;
+        jobs.pid[h] = pid;
+        release_capture_writer(output);
+        if (pid < 0)
+            close_output_capture(output);
+        if (pid > 0)
+        {
+            // Wait for the child to park itself so a later SIGCONT to its
+            // process group cannot race ahead of setpgid/raise.
+            setpgid(pid, pid);
+            int status;
+            while (waitpid(pid, &status, WUNTRACED) == -1 && errno == EINTR)
+                ;
+            // A restart must find this pid, or it would run the job twice.
+            if (job_checkpoint && h < checkpoint_header(*job_checkpoint)->job_count)
+                write_checkpoint_job(*job_checkpoint, jobs, h);
+        }
+    }
+}
+
+// Stops a running child and waits until the kernel reports it stopped.
+// Returns 1 once stopped, 0 if it exited first (*status_out holds the wait
+// status) and -1 if it was already reaped.
+inline int stop_child(pid_t pid, int *status_out)
+{
+    kill(-pid, SIGSTOP);
+    int status;
+    pid_t r;
+    while ((r = waitpid(pid, &status, WUNTRACED)) == -1 && errno == EINTR)
+        ;
+    if (r != pid)
+        return -1;
+    if (WIFSTOPPED(status))
+        return 1;
+    *status_out = status;
+    return 0;
+}
+
+inline int count_live_children(const JobTable &jobs)
+{
+    int live = 0;
+    for (JobHandle h = 0; h < jobs.size(); ++h)
+        if (jobs.pid[h] > 0 && !jobs.finished(h))
+            live++;
+    return live;
+}
+
+// Closes the job's output pipe and hands its runtime slot back to the pool.
+static void release_job_runtime(JobTable &jobs, JobHandle h)
+{
+    if (jobs.runtime_slot[h] < 0)
+        return;
+    JobRuntime &rt = jobs.runtime(h);
+    close_output_capture(rt.output);
+    jobs.metrics[h].output_bytes = rt.output.bytes;
+    jobs.metrics[h].splice_us = static_cast<uint32_t>(min<uint64_t>(rt.output.splice_us, UINT32_MAX));
+    if (rt.pidfd >= 0)
+        close(rt.pidfd);
+    jobs.release_runtime(h);
+}
+
+static void notify_job_finished(JobTable &jobs, JobHandle h, uint64_t now);
+
+// Marks a job that never got to run (shed, failed to spawn or lost a
+// dependency) as a failure.
+static void reject_process(JobTable &jobs, JobHandle h, uint64_t now)
+{
+    JobMetrics &m = jobs.metrics[h];
+    jobs.set_state(h, JOB_FINISHED | JOB_ERROR, true);
+    jobs.set_state(h, JOB_BLOCKED, false);
+    m.completion_time = static_cast<uint32_t>(now);
+    m.turnaround_time = m.completion_time - m.arrival_time;
+    m.waiting_time = m.turnaround_time;
+    release_job_runtime(jobs, h);
+    notify_job_finished(jobs, h, now);
+}
+
+// Called once h has finished: children whose last dependency this was
+// become ready; if h failed, everything downstream fails with it.
+static void release_dependents(JobTable &jobs, JobHandle h, uint64_t now)
+{
+    auto it = jobs.dag.find(h);
+    if (it == jobs.dag.end())
+        return;
+    vector<JobHandle> children = it->second.children;
+    bool failed = jobs.error(h);
+    for (JobHandle c : children)
+    {
+        if (jobs.finished(c))
+            continue;
+        if (failed)
+        {
+            reject_process(jobs, c, now);
+            continue;
+        }
+        DagNode &node = jobs.dag[c];
+        if (node.pending > 0 && --node.pending == 0)
+            jobs.set_state(c, JOB_BLOCKED, false);
+    }
+}
+
+// Writes as much of the completion backlog as completion_fd takes. It may
+// share a non-blocking file description with stdin, so a full socket only
+// defers the rest; with wait, blocks until everything is out.
+static void flush_completions(bool wait = false)
+{
+    while (completion_fd >= 0 && !completion_backlog.empty())
+    {
+        ssize_t n = write(completion_fd, completion_backlog.data(), completion_backlog.size());
+        if (n > 0)
+        {
+            completion_backlog.erase(0, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            if (!wait)
+                return;
+            struct pollfd p = {completion_fd, POLLOUT, 0};
+            poll(&p, 1, -1);
+            continue;
+        }
+        completion_fd = -1; // reader went away; stop reporting
+        completion_backlog.clear();
+    }
+}
+
+// One line per finished job on completion_fd:
+//     <handle> <error 0|1> <turnaround_ms> <response_ms>
+static void report_completion(const JobTable &jobs, JobHandle h)
+{
+    if (completion_fd < 0)
+        return;
+    const JobMetrics &m = jobs.metrics[h];
+    char line[96];
+    int n = snprintf(line, sizeof(line), "%u %d %u %u\n", h, jobs.error(h) ? 1 : 0,
+                     m.turnaround_time, m.response_time);
+    completion_backlog.append(line, static_cast<size_t>(n));
+    flush_completions();
+}
+
+// Every path that finishes a job ends here, after its metrics are final.
+static void notify_job_finished(JobTable &jobs, JobHandle h, uint64_t now)
+{
+    report_completion(jobs, h);
+    if (job_checkpoint && h < checkpoint_header(*job_checkpoint)->job_count)
+        write_checkpoint_job(*job_checkpoint, jobs, h);
+    release_dependents(jobs, h, now);
+}
+
+// Recomputes the longest downstream chain of h and pushes any change up to
+// its own dependencies.
+static void propagate_critical_path(JobTable &jobs, JobHandle h)
+{
+    DagNode &node = jobs.dag[h];
+    double longest = 0.0;
+    for (JobHandle c : node.children)
+    {
+        const DagNode &child = jobs.dag[c];
+        longest = max(longest, child.est_ms + child.downstream_ms);
     }
+    if (longest == node.downstream_ms)
+        return;
+    node.downstream_ms = longest;
+    vector<JobHandle> parents = node.parents;
+    for (JobHandle p : parents)
+        if (!jobs.finished(p))
+            propagate_critical_path(jobs, p);
+}
+
+// Records that h runs only after every job in deps has finished.
+static void add_job_dependencies(JobTable &jobs, JobHandle h, const vector<long> &deps, double est_ms, uint64_t now)
+{
+    DagNode &node = jobs.dag[h];
+    node.est_ms = est_ms;
+    bool failed_dep = false;
+    for (long d : deps)
+    {
+        if (d < 0 || static_cast<JobHandle>(d) >= h)
+        {
+            cerr << "Job " << h << ": ignoring dependency on unknown job " << d << "\n";
+            continue;
+        }
+        JobHandle p = static_cast<JobHandle>(d);
+        jobs.dag[p].children.push_back(h);
+        jobs.dag[h].parents.push_back(p);
+        if (jobs.finished(p))
+            failed_dep = failed_dep || jobs.error(p);
+        else
+            jobs.dag[h].pending++;
+    }
+    if (failed_dep)
+    {
+        reject_process(jobs, h, now);
+        return;
+    }
+    if (jobs.dag[h].pending > 0)
+        jobs.set_state(h, JOB_BLOCKED, true);
+    for (JobHandle p : jobs.dag[h].parents)
+        if (!jobs.finished(p))
+            propagate_critical_path(jobs, p);
+}
+
+// Priority credit for jobs others are waiting on: the longer the predicted
+// chain behind a job, the earlier it should run.
+inline double critical_path_boost_ms(const JobTable &jobs, JobHandle h)
+{
+    if (jobs.dag.empty())
+        return 0.0;
+    auto it = jobs.dag.find(h);
+    return it == jobs.dag.end() ? 0.0 : CRITICAL_PATH_WEIGHT * it->second.downstream_ms;
 }
 
 inline bool check_child_exited(pid_t pid, int *status_out)
@@ -149,7 +435,78 @@ inline bool check_child_exited(pid_t pid, int *status_out)
     return true;
 }
 
-inline void write_results_to_csv(const vector<OnlineProcess> &processes, const string &filename)
+// check_child_exited for any job, including ones re-adopted after a restart.
+// Those are not our children: the pidfd (or /proc) shows when they are gone
+// and the supervisor, their parent, records the wait status.
+static bool job_exited(JobTable &jobs, JobHandle h, int *status_out)
+{
+    if (jobs.runtime_slot[h] < 0 || !jobs.runtime(h).adopted)
+        return check_child_exited(jobs.pid[h], status_out);
+    JobRuntime &rt = jobs.runtime(h);
+    pid_t pid = jobs.pid[h];
+    bool gone;
+    if (rt.pidfd >= 0)
+        gone = pidfd_exited(rt.pidfd);
+    else
+    {
+        char state;
+        uint64_t start = 0;
+        gone = !read_proc_state(pid, state, start) || state == 'Z' || start != rt.proc_start;
+    }
+    if (!gone)
+        return false;
+    if (find_orphan_exit(orphan_exits_file, pid, *status_out))
+        return true;
+    uint64_t now = now_ms();
+    if (rt.exit_seen_ms == 0)
+        rt.exit_seen_ms = now;
+    if (now - rt.exit_seen_ms < ADOPTED_EXIT_GRACE_MS)
+        return false;
+    cerr << "No exit status for adopted job " << h << " (pid " << pid << ")\n";
+    *status_out = 255 << 8;
+    return true;
+}
+
+// stop_child for any job; adopted jobs are confirmed stopped through /proc.
+static int stop_job(JobTable &jobs, JobHandle h, int *status_out)
+{
+    if (jobs.runtime_slot[h] < 0 || !jobs.runtime(h).adopted)
+        return stop_child(jobs.pid[h], status_out);
+    kill(-jobs.pid[h], SIGSTOP);
+    for (int i = 0; i < 100; ++i)
+    {
+        if (job_exited(jobs, h, status_out))
+            return 0;
+        char state;
+        uint64_t start;
+        if (read_proc_state(jobs.pid[h], state, start) && (state == 'T' || state == 't'))
+            return 1;
+        usleep(1000);
+    }
+    return 1;
+}
+
+#define ONLINE_CSV_HEADER "Command,Finished,Error,CompletionTime,Turnaround,Waiting,Response,TotalCPU,OutputBytes,OutputKBps,SpliceUs,Weight,DeadlineMissed\n"
+
+inline void write_job_csv_row(ostream &out, const JobTable &jobs, const CommandArena &arena, JobHandle h)
+{
+    const JobMetrics &m = jobs.metrics[h];
+    out << "\"" << arena.c_str(jobs.history_index[h]) << "\","
+        << (jobs.finished(h) ? "Yes" : "No") << ","
+        << (jobs.error(h) ? "Yes" : "No") << ","
+        << m.completion_time << ","
+        << m.turnaround_time << ","
+        << m.waiting_time << ","
+        << m.response_time << ","
+        << jobs.total_cpu_ms[h] << ","
+        << m.output_bytes << ","
+        << output_kbps(m.output_bytes, jobs.total_cpu_ms[h]) << ","
+        << m.splice_us << ","
+        << jobs.weight[h] << ","
+        << (m.deadline_ms == 0 ? "-" : (jobs.finished(h) && m.turnaround_time > m.deadline_ms ? "Yes" : "No")) << "\n";
+}
+
+inline void write_results_to_csv(const JobTable &jobs, const CommandArena &arena, const string &filename)
 {
     ofstream fp(filename);
     if (!fp)
@@ -157,83 +514,176 @@ inline void write_results_to_csv(const vector<OnlineProcess> &processes, const s
         cerr << "Could not open file " << filename << "\n";
         return;
     }
-    fp << "Command,Finished,Error,CompletionTime,Turnaround,Waiting,Response,TotalCPU\n";
-    for (const auto &p : processes)
+    fp << ONLINE_CSV_HEADER;
+    for (JobHandle h = 0; h < jobs.size(); ++h)
+        write_job_csv_row(fp, jobs, arena, h);
+}
+
+// A submission may start with any of these prefixes, each followed by a space:
+//   after:<id>[,<id>...]  run only once those jobs finished. Ids are submission
+//                         order from 0; negative ids are relative (after:-1 is
+//                         the job submitted just before), which keeps traces loopable.
+//   weight:<w>            priority scale, as the trace weight column
+//   deadline:<ms>         turnaround target, as the trace deadline column
+struct Submission
+{
+    vector<long> deps; // as written, relative ids not yet resolved
+    double weight = 1.0;
+    uint32_t deadline_ms = 0;
+    const char *cmd = nullptr; // what is left after the prefixes
+    size_t len = 0;
+};
+
+// Splits the prefixes off cmd. weight and deadline_ms are the defaults the
+// prefixes override.
+inline Submission parse_submission(const char *cmd, size_t len, double weight = 1.0, uint32_t deadline_ms = 0)
+{
+    Submission sub;
+    sub.weight = weight;
+    sub.deadline_ms = deadline_ms;
+    while (true)
     {
-        fp << "\"" << p.command << "\","
-           << (p.finished ? "Yes" : "No") << ","
-           << (p.error ? "Yes" : "No") << ","
-           << p.completion_time << ","
-           << p.turnaround_time << ","
-           << p.waiting_time << ","
-           << p.response_time << ","
-           << p.total_cpu_time << "\n";
+        size_t i;
+        if (len > 6 && memcmp(cmd, "after:", 6) == 0)
+        {
+            i = 6;
+            while (i < len && cmd[i] != ' ')
+            {
+                char *end;
+                long id = strtol(cmd + i, &end, 10);
+                if (end == cmd + i)
+                    break;
+                sub.deps.push_back(id);
+                i = static_cast<size_t>(end - cmd);
+                if (i < len && cmd[i] == ',')
+                    i++;
+            }
+        }
+        else if (len > 7 && memcmp(cmd, "weight:", 7) == 0)
+        {
+            double w = strtod(cmd + 7, nullptr);
+            if (w > 0.0)
+                sub.weight = w;
+            i = 7;
+        }
+        else if (len > 9 && memcmp(cmd, "deadline:", 9) == 0)
+        {
+            sub.deadline_ms = static_cast<uint32_t>(strtoul(cmd + 9, nullptr, 10));
+            i = 9;
+        }
+        else
+            break;
+        while (i < len && cmd[i] != ' ')
+            i++;
+        while (i < len && cmd[i] == ' ')
+            i++;
+        cmd += i;
+        len -= i;
     }
+    sub.cmd = cmd;
+    sub.len = len;
+    return sub;
 }
 
+// Queues one submission (see parse_submission for its prefixes). Returns
+// NO_JOB if nothing is left after the prefixes.
+inline JobHandle enqueue_command(JobTable &jobs, CommandArena &arena, vector<CmdHistory> &cmd_history,
+                                 const char *line, size_t line_len, uint64_t arrival,
+                                 double weight = 1.0, uint32_t deadline_ms = 0)
+{
+    Submission sub = parse_submission(line, line_len, weight, deadline_ms);
+    const char *cmd = sub.cmd;
+    size_t len = sub.len;
+    if (len == 0)
+    {
+        cerr << "Submission has prefixes but no command, ignored\n";
+        return NO_JOB;
+    }
+
+    // Arrivals stay lightweight descriptors; the child is only forked once
+    // admission control lets the job start.
+    int hist = ensure_history_index(arena, cmd_history, cmd, len);
+    JobHandle h = jobs.add(hist, static_cast<uint32_t>(arrival));
+    jobs.weight[h] = static_cast<float>(sub.weight);
+    jobs.metrics[h].deadline_ms = sub.deadline_ms;
+    if (!sub.deps.empty())
+    {
+        for (long &d : sub.deps)
+            if (d < 0)
+                d += static_cast<long>(h);
+        double est = get_avg_burst_ms(cmd_history, hist, 3);
+        add_job_dependencies(jobs, h, sub.deps, est < 0.0 ? DEFAULT_BURST_ESTIMATE_MS : est, arrival);
+        cout << "Job " << h << " waits on " << jobs.dag[h].pending << " job(s): "
+             << arena.c_str(static_cast<uint32_t>(hist)) << "\n";
+    }
+    return h;
+}
+
+// Reads whatever complete lines stdin has. Each line is one job; with a
+// recorder every submission is also appended to its trace. Lines longer than
+// MAX_CMD_LEN are dropped whole. *eof is set once stdin is closed.
 inline int poll_and_enqueue_new_commands(
-    vector<OnlineProcess> &proc_table,
+    JobTable &jobs,
+    CommandArena &arena,
     vector<CmdHistory> &cmd_history,
-    uint64_t now)
+    uint64_t now,
+    TraceRecorder *recorder = nullptr,
+    bool *eof = nullptr)
 {
     static char buf[8192];
     static size_t leftover = 0;
+    static bool dropping = false; // inside an overlong line, skipping to its newline
     int added = 0;
+    static_assert(MAX_CMD_LEN < sizeof(buf), "a whole command must fit in the read buffer");
 
     while (true)
     {
-        ssize_t r = read(STDIN_FILENO, buf + leftover, sizeof(buf) - leftover - 1);
+        ssize_t r = read(STDIN_FILENO, buf + leftover, sizeof(buf) - leftover);
         if (r < 0)
+            break; // EAGAIN or a real error; try again on the next poll
+        if (r == 0)
         {
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
-                break;
-            else
-                break;
-        }
-        else if (r == 0)
-        {
+            if (eof)
+                *eof = true;
             break;
         }
-        else
-        {
-            leftover += static_cast<size_t>(r);
-            buf[leftover] = '\0';
-            char *line_start = buf;
-            char *nl;
 
-            while ((nl = strchr(line_start, '\n')) != nullptr)
+        leftover += static_cast<size_t>(r);
+        char *line_start = buf;
+        char *end = buf + leftover;
+        char *nl;
+        while ((nl = static_cast<char *>(memchr(line_start, '\n', static_cast<size_t>(end - line_start)))) != nullptr)
+        {
+            size_t linelen = static_cast<size_t>(nl - line_start);
+            while (linelen > 0 && line_start[linelen - 1] == '\r')
+                linelen--;
+
+            if (dropping)
+                dropping = false;
+            else if (linelen > MAX_CMD_LEN)
+                cerr << "Command of " << linelen << " bytes is longer than " << MAX_CMD_LEN << ", dropped\n";
+            else if (linelen > 0)
             {
-                size_t linelen = static_cast<size_t>(nl - line_start);
-                while (linelen > 0 && (line_start[linelen - 1] == '\r' || line_start[linelen - 1] == '\n'))
-                    linelen--;
-
-                string cmd(line_start, linelen);
-                if (!cmd.empty())
+                if (enqueue_command(jobs, arena, cmd_history, line_start, linelen, now) != NO_JOB)
                 {
-                    OnlineProcess p;
-                    p.command = cmd;
-                    p.arrival_time = now;
-                    p.history_index = ensure_history_index(cmd_history, cmd);
-
-                    spawn_and_stop_child(p);
-                    if (p.pid <= 0)
-                    {
-                        p.error = true;
-                        p.finished = true;
-                        p.completion_time = now_ms();
-                    }
-
-                    proc_table.push_back(p);
+                    if (recorder)
+                        record_trace_entry(*recorder, now, 1.0, 0, line_start, linelen);
                     added++;
                 }
-                line_start = nl + 1;
             }
+            line_start = nl + 1;
+        }
 
-            size_t remaining = strlen(line_start);
-            memmove(buf, line_start, remaining);
-            leftover = remaining;
-            buf[leftover] = '\0';
+        leftover = static_cast<size_t>(end - line_start);
+        if (leftover > MAX_CMD_LEN)
+        {
+            if (!dropping)
+                cerr << "Command longer than " << MAX_CMD_LEN << " bytes, dropped\n";
+            dropping = true;
+            leftover = 0;
         }
+        else
+            memmove(buf, line_start, leftover);
     }
     return added;
 }
@@ -247,285 +697,817 @@ public:
         program_start_ms = now_ms();
     }
 
+    ~OnlineScheduler()
+    {
+        close_trace(replay);
+        close_trace_recorder(recorder);
+        finish_checkpoint();
+        flush_completions(true);
+    }
+
     void ShortestJobFirst(int k);
     void MultiLevelFeedbackQueue(int q0, int q1, int q2, int boostTime);
 
+    // Lets MLFQ retune its quanta and boost interval online from the measured
+    // switch cost and burst distribution, within the given bounds.
+    void EnableAdaptiveQuanta(const QuantumBounds &bounds = QuantumBounds())
+    {
+        tuner.bounds = bounds;
+        tuner.enabled = true;
+    }
+
+    // Map MLFQ levels / SJF estimates onto kernel policy and nice values
+    // (on by default) so the kernel enforces the ordering between ticks.
+    void SetKernelPriorities(bool enable)
+    {
+        kernel_priorities = enable;
+    }
+
+    // Capture each job's stdout/stderr into JOB_OUTPUT_DIR/<job>.log (on by
+    // default) instead of letting it interleave with the scheduler's log.
+    void SetOutputCapture(bool enable)
+    {
+        capture_output = enable;
+    }
+
+    // Feed submissions from a trace file at their recorded offsets instead of
+    // (or, with read_stdin_too, as well as) stdin. speedup > 1 compresses
+    // time; loops = 0 repeats the trace forever.
+    bool ReplayTrace(const string &path, double speedup = 1.0, int loops = 1, bool read_stdin_too = false)
+    {
+        if (!open_trace(replay, path, speedup, loops))
+            return false;
+        read_stdin = read_stdin_too;
+        return true;
+    }
+
+    // Append every stdin submission to a trace file in the replay format.
+    bool RecordTrace(const string &path)
+    {
+        return open_trace_recorder(recorder, path, now_ms());
+    }
+
+    // Thresholds for holding back or rejecting new job starts under pressure.
+    void SetAdmissionLimits(const AdmissionLimits &limits)
+    {
+        admission.limits = limits;
+    }
+
+    // Prepended to the result CSV names, e.g. "shard0_" when several
+    // schedulers share a working directory.
+    void SetResultPrefix(const string &prefix)
+    {
+        result_prefix = prefix;
+    }
+
+    // Report every finished job as a line on fd (see report_completion), so
+    // a front end can track outstanding work and latency live.
+    void SetCompletionFd(int fd)
+    {
+        completion_fd = fd;
+    }
+
+    // Checkpoint jobs, queue levels, CPU times and command histories to an
+    // mmap'd file every CHECKPOINT_INTERVAL_MS, restoring from it first: live
+    // jobs of a previous run are re-adopted and requeued, and a run that
+    // finished cleanly still leaves its histories warm. On SIGTERM the
+    // scheduler checkpoints and exits with SCHED_RESTART_EXIT, leaving its
+    // jobs for the next instance (see Supervisor.h).
+    bool EnableCheckpoint(const string &path);
+
+    // Read-only view of every job submitted so far, for benchmarks and reports.
+    const JobTable &Jobs() const
+    {
+        return jobs;
+    }
+
 private:
-    vector<OnlineProcess> proc_table;
+    JobTable jobs;
+    CommandArena commands; // shared by the job table and cmd_histories
     vector<CmdHistory> cmd_histories;
+    QuantumTuner tuner;
+    AdmissionControl admission;
+    bool kernel_priorities = true;
+    bool capture_output = true;
+    TraceReplay replay;
+    TraceRecorder recorder;
+    bool read_stdin = true;
+    bool stdin_eof = false;
     uint64_t program_start_ms;
+    string result_prefix;
+    CheckpointFile checkpoint;
+    uint64_t last_checkpoint_ms = 0;
+    bool restored = false;           // resumed a previous run's timeline
+    uint32_t saved_edges = 0;        // dependency edges already in the file
+    JobHandle edges_saved_upto = 0;  // jobs whose edges were appended
+    uint32_t saved_commands = 0;     // arena strings already in the file
+    uint64_t saved_arena_bytes = 0;
+
+    int poll_submissions();
+    bool input_closed() const;
+    bool wait_for_submissions();
+    void save_checkpoint(uint64_t now);
+    void restore_checkpoint();
+    void checkpoint_tick(uint64_t now);
+    void checkpoint_before_spawn(JobHandle h);
+    void finish_checkpoint();
 };
 
-void OnlineScheduler::ShortestJobFirst(int k)
+inline int OnlineScheduler::poll_submissions()
+{
+    uint64_t now = now_ms();
+    int added = 0;
+    flush_completions();
+    if (read_stdin && !stdin_eof)
+        added += poll_and_enqueue_new_commands(jobs, commands, cmd_histories, now,
+                                               recorder.out ? &recorder : nullptr, &stdin_eof);
+    added += poll_trace(replay, now, [&](const TraceEntry &e, uint64_t due) {
+        enqueue_command(jobs, commands, cmd_histories, e.cmd, e.cmd_len, due, e.weight, e.deadline_ms);
+    });
+    return added;
+}
+
+// True once no further submissions can arrive.
+inline bool OnlineScheduler::input_closed() const
+{
+    return (!read_stdin || stdin_eof) && replay.done;
+}
+
+// Blocks until stdin has data or the next trace entry is due. Returns false
+// when every input is exhausted.
+inline bool OnlineScheduler::wait_for_submissions()
+{
+    if (input_closed())
+        return false;
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    int nfds = 0;
+    if (read_stdin && !stdin_eof)
+    {
+        FD_SET(STDIN_FILENO, &rfds);
+        nfds = STDIN_FILENO + 1;
+    }
+    struct timeval tv;
+    struct timeval *timeout = nullptr;
+    if (!replay.done)
+    {
+        uint64_t now = now_ms();
+        uint64_t due = replay.start_ms == 0 ? now : trace_due_ms(replay);
+        uint64_t wait = due > now ? due - now : 0;
+        tv.tv_sec = static_cast<time_t>(wait / 1000);
+        tv.tv_usec = static_cast<suseconds_t>((wait % 1000) * 1000);
+        timeout = &tv;
+    }
+    select(nfds, &rfds, nullptr, nullptr, timeout);
+    return true;
+}
+
+inline void OnlineScheduler::ShortestJobFirst(int k)
 {
     set_stdin_nonblocking(true);
-    poll_and_enqueue_new_commands(proc_table, cmd_histories, now_ms());
+    if (kernel_priorities)
+        raise_scheduler_priority();
+    poll_submissions();
 
     while (true)
     {
-        poll_and_enqueue_new_commands(proc_table, cmd_histories, now_ms());
+        checkpoint_tick(now_ms());
+        poll_submissions();
 
         int active = 0;
-        for (auto &p : proc_table)
-            if (!p.finished)
+        for (JobHandle h = 0; h < jobs.size(); ++h)
+            if (!jobs.finished(h))
                 active++;
 
         if (active == 0)
         {
-            fd_set rfds;
-            FD_ZERO(&rfds);
-            FD_SET(STDIN_FILENO, &rfds);
-            int sel = select(STDIN_FILENO + 1, &rfds, nullptr, nullptr, nullptr);
-            if (sel > 0)
-                continue;
-            if (sel == -1 && errno == EINTR)
-                continue;
-            break;
+            if (!wait_for_submissions())
+                break;
+            continue;
         }
 
         int best_idx = -1;
         double best_est = 1e308;
 
-        for (int i = 0; i < (int)proc_table.size(); ++i)
+        for (JobHandle h = 0; h < jobs.size(); ++h)
         {
-            auto &p = proc_table[i];
-            if (p.finished)
+            if (jobs.state[h] & (JOB_FINISHED | JOB_BLOCKED))
                 continue;
-            double avg = get_avg_burst_ms(cmd_histories, p.history_index, k);
-            double est = (avg < 0.0) ? 1000.0 : avg;
+            double avg = get_avg_burst_ms(cmd_histories, jobs.history_index[h], k);
+            double est = ((avg < 0.0) ? DEFAULT_BURST_ESTIMATE_MS : avg) / jobs.weight[h]
+                         - critical_path_boost_ms(jobs, h);
             if (est < best_est)
             {
                 best_est = est;
-                best_idx = i;
+                best_idx = static_cast<int>(h);
             }
         }
 
         if (best_idx == -1)
             break;
-        OnlineProcess &job = proc_table[best_idx];
-        if (job.pid == -1)
-            spawn_and_stop_child(job);
+        JobHandle job = static_cast<JobHandle>(best_idx);
+        const char *command = commands.c_str(jobs.history_index[job]);
+        if (jobs.pid[job] == -1)
+        {
+            AdmissionDecision gate = admit_new_start(admission, count_live_children(jobs), now_ms());
+            if (gate == SHED)
+            {
+                reject_process(jobs, job, now_ms());
+                admission.shed_jobs++;
+                cout << "Admission shed: " << command << "\n";
+                write_results_to_csv(jobs, commands, result_prefix + "result_online_SJF.csv");
+                continue;
+            }
+            if (gate == THROTTLE)
+            {
+                this_thread::sleep_for(chrono::milliseconds(POLL_SLEEP_MS));
+                continue;
+            }
+            checkpoint_before_spawn(job);
+            spawn_and_stop_child(jobs, job, command, capture_output ? job_output_path(best_idx, result_prefix) : "");
+            if (jobs.pid[job] <= 0)
+            {
+                reject_process(jobs, job, now_ms());
+                continue;
+            }
+        }
 
-        kill(-job.pid, SIGCONT);
-        if (!job.started)
+        JobRuntime &rt = jobs.runtime(job);
+        int kernel_level = sjf_kernel_level(best_est);
+        if (kernel_priorities && rt.kernel_level != kernel_level && apply_kernel_priority(jobs.pid[job], kernel_level))
+            rt.kernel_level = kernel_level;
+        kill(-jobs.pid[job], SIGCONT);
+        JobMetrics &m = jobs.metrics[job];
+        if (!jobs.started(job))
         {
-            job.started = true;
-            job.response_time = now_ms() - job.arrival_time;
+            jobs.set_state(job, JOB_STARTED, true);
+            m.response_time = static_cast<uint32_t>(now_ms()) - m.arrival_time;
         }
 
         uint64_t start = now_ms();
         while (true)
         {
             int status = 0;
-            if (check_child_exited(job.pid, &status))
+            drain_output_capture(rt.output);
+            if (handoff_requested)
+                checkpoint_tick(now_ms()); // leaves the job running for the next instance
+            if (job_exited(jobs, job, &status))
             {
                 uint64_t end = now_ms();
                 uint64_t ran = end - start;
-                job.finished = true;
-                job.total_cpu_time += ran;
-                job.completion_time = end;
-                job.turnaround_time = job.completion_time - job.arrival_time;
-                job.waiting_time = job.turnaround_time - job.total_cpu_time;
-                record_burst_to_history(cmd_histories, job.history_index, (double)ran);
+                jobs.set_state(job, JOB_FINISHED, true);
+                jobs.set_state(job, JOB_ERROR, !WIFEXITED(status) || WEXITSTATUS(status) != 0);
+                jobs.total_cpu_ms[job] += static_cast<uint32_t>(ran);
+                m.completion_time = static_cast<uint32_t>(end);
+                m.turnaround_time = m.completion_time - m.arrival_time;
+                m.waiting_time = m.turnaround_time - jobs.total_cpu_ms[job];
+                record_burst_to_history(cmd_histories, jobs.history_index[job], (double)ran);
+                release_job_runtime(jobs, job);
+                notify_job_finished(jobs, job, end);
                 break;
             }
             this_thread::sleep_for(chrono::milliseconds(50));
         }
 
-        write_results_to_csv(proc_table, "result_online_SJF.csv");
+        write_results_to_csv(jobs, commands, result_prefix + "result_online_SJF.csv");
     }
 
+    print_admission_summary(admission, "SJF");
     set_stdin_nonblocking(false);
 }
 
-static void finalize_proc_metrics(OnlineProcess &p)
+static void finalize_proc_metrics(JobTable &jobs, JobHandle h)
 {
-    if (!p.finished)
+    if (!jobs.finished(h))
         return;
 
-    p.turnaround_time = p.completion_time - p.arrival_time;
+    JobMetrics &m = jobs.metrics[h];
+    m.turnaround_time = m.completion_time - m.arrival_time;
 
-    if (p.total_cpu_time > p.turnaround_time)
-        p.waiting_time = 0;
+    if (jobs.total_cpu_ms[h] > m.turnaround_time)
+        m.waiting_time = 0;
     else
-        p.waiting_time = p.turnaround_time - p.total_cpu_time;
-
-    if (p.slice_start_ms > 0 && p.response_time == 0 && p.started)
-    {
-        p.response_time = p.slice_start_ms - p.arrival_time;
-    }
+        m.waiting_time = m.turnaround_time - jobs.total_cpu_ms[h];
 }
 
 static void complete_process(
-    OnlineProcess &p,
+    JobTable &jobs,
+    JobHandle h,
     uint64_t end_ms,
     bool wstatus_valid,
     int wstatus,
     ofstream &csv,
+    const CommandArena &arena,
     vector<CmdHistory> &cmd_history)
 {
-    if (p.finished)
+    if (jobs.finished(h))
         return;
 
-    p.finished = true;
-    p.completion_time = end_ms;
+    jobs.set_state(h, JOB_FINISHED, true);
+    jobs.metrics[h].completion_time = static_cast<uint32_t>(end_ms);
 
     if (wstatus_valid)
     {
         if (WIFEXITED(wstatus))
-            p.error = (WEXITSTATUS(wstatus) != 0);
+            jobs.set_state(h, JOB_ERROR, WEXITSTATUS(wstatus) != 0);
         else
-            p.error = true;
+            jobs.set_state(h, JOB_ERROR, true);
     }
 
-    if (!p.error && p.history_index >= 0)
+    if (!jobs.error(h) && jobs.history_index[h] >= 0)
     {
-        record_burst_to_history(cmd_history, p.history_index, static_cast<double>(p.total_cpu_time));
+        record_burst_to_history(cmd_history, jobs.history_index[h], static_cast<double>(jobs.total_cpu_ms[h]));
     }
 
-    finalize_proc_metrics(p);
+    finalize_proc_metrics(jobs, h);
+    release_job_runtime(jobs, h);
+    notify_job_finished(jobs, h, end_ms);
 
-    cout << "Context switch: " << p.command
-         << " | Start: " << p.slice_start_ms
+    cout << "Context switch: " << arena.c_str(jobs.history_index[h])
+         << " | Start: " << jobs.metrics[h].slice_start_ms
          << " | End: " << end_ms << "\n";
 
-    csv << "\"" << p.command << "\","
-        << (p.finished ? "Yes" : "No") << ","
-        << (p.error ? "Yes" : "No") << ","
-        << p.completion_time << ","
-        << p.turnaround_time << ","
-        << p.waiting_time << ","
-        << p.response_time << ","
-        << p.total_cpu_time << "\n";
+    write_job_csv_row(csv, jobs, arena, h);
+    csv.flush();
 }
 
-static void print_context_switch(const string &cmd, uint64_t start_ms, uint64_t end_ms)
+static void print_context_switch(const char *cmd, uint64_t start_ms, uint64_t end_ms)
 {
     cout << cmd << ", " << start_ms << ", " << end_ms << endl;
     cout.flush();
 }
 
-static void promote_all_to_q0(queue<int> &q0arr,
-                              queue<int> &q1arr,
-                              queue<int> &q2arr,
-                              int max_procs,
-                              const function<bool(int)> &is_queued)
+static queue<JobHandle> &level_queue(int level)
 {
-    vector<int> leftover_q1;
-    while (!q1arr.empty())
+    return level == 0 ? q0arr : (level == 1 ? q1arr : q2arr);
+}
+
+static void push_to_level(JobTable &jobs, JobHandle h, int level)
+{
+    jobs.level[h] = static_cast<int8_t>(level);
+    level_queue(level).push(h);
+}
+
+// Takes the next job off a level; -1 if the level is empty.
+static int pop_from_level(JobTable &jobs, int level)
+{
+    queue<JobHandle> &q = level_queue(level);
+    if (q.empty())
+        return -1;
+    JobHandle h = q.front();
+    q.pop();
+    jobs.level[h] = -1;
+    return static_cast<int>(h);
+}
+
+inline bool is_queued(const JobTable &jobs, JobHandle h)
+{
+    return jobs.level[h] >= 0;
+}
+
+static void promote_all_to_q0(JobTable &jobs, int max_procs)
+{
+    for (int from = 1; from <= 2; ++from)
     {
-        int idx = q1arr.front();
-        q1arr.pop();
-        if (!is_queued(idx))
-            continue;
-        if ((int)q0arr.size() < max_procs)
-            q0arr.push(idx);
+        queue<JobHandle> &src = level_queue(from);
+        queue<JobHandle> leftover; // could not promote, keep in place
+        while (!src.empty())
+        {
+            JobHandle h = src.front();
+            src.pop();
+            if (!is_queued(jobs, h))
+                continue;
+            if ((int)q0arr.size() < max_procs)
+            {
+                jobs.level[h] = 0;
+                q0arr.push(h);
+            }
+            else
+                leftover.push(h);
+        }
+        src.swap(leftover);
+    }
+}
+
+// Removes and returns the first job in the level that already has a child,
+// keeping the order of everything else; -1 if there is none.
+static int pop_first_started(JobTable &jobs, int level)
+{
+    queue<JobHandle> &q = level_queue(level);
+    int found = -1;
+    size_t n = q.size();
+    for (size_t i = 0; i < n; ++i)
+    {
+        JobHandle h = q.front();
+        q.pop();
+        if (found < 0 && jobs.pid[h] > 0 && !jobs.finished(h))
+            found = static_cast<int>(h);
         else
+            q.push(h);
+    }
+    if (found >= 0)
+        jobs.level[found] = -1;
+    return found;
+}
+
+// Jobs that blocked mid-slice keep running outside the queues, since sleeping
+// costs no CPU. Once one can run again it is stopped and rejoins its level.
+static void wake_io_waiters(JobTable &jobs, vector<JobHandle> &waiters, ofstream &csv,
+                            const CommandArena &arena, vector<CmdHistory> &cmd_history)
+{
+    for (size_t i = 0; i < waiters.size();)
+    {
+        JobHandle h = waiters[i];
+        JobRuntime &rt = jobs.runtime(h);
+        uint64_t now = now_ms();
+        int wstatus = 0;
+        drain_output_capture(rt.output);
+        bool done = job_exited(jobs, h, &wstatus);
+        if (!done)
         {
-            leftover_q1.push_back(idx);  // Could not promote, keep in q1
+            ProcSample s = read_proc_sample(jobs.pid[h], now);
+            bool runnable = !s.valid || s.cpu_ms > rt.last_sample.cpu_ms ||
+                            !is_sleeping_state(s.state) || !proc_descendants_sleeping(jobs.pid[h]);
+            if (s.valid)
+                rt.last_sample = s;
+            if (!runnable)
+            {
+                ++i;
+                continue;
+            }
+            int stopped = stop_job(jobs, h, &wstatus);
+            if (stopped == 1)
+            {
+                jobs.set_state(h, JOB_IO_WAIT, false);
+                push_to_level(jobs, h, rt.io_wait_level);
+            }
+            else
+                complete_process(jobs, h, now, stopped == 0, wstatus, csv, arena, cmd_history);
         }
+        else
+            complete_process(jobs, h, now, true, wstatus, csv, arena, cmd_history);
+        waiters[i] = waiters.back();
+        waiters.pop_back();
     }
-    queue<int> temp;
-    for (int idx : leftover_q1)
-        temp.push(idx);
-    q1arr.swap(temp);
+}
 
-    // Promote all from q2 to q0
-    vector<int> leftover_q2;
-    while (!q2arr.empty())
+static void place_new_arrivals_mlfq(JobTable &jobs,
+                                    vector<CmdHistory> &cmd_histories,
+                                    int q0_time, int q1_time)
+{
+    for (JobHandle h = 0; h < jobs.size(); ++h)
     {
-        int idx = q2arr.front();
-        q2arr.pop();
-        if (!is_queued(idx))
+        if ((jobs.state[h] & (JOB_FINISHED | JOB_BLOCKED | JOB_IO_WAIT)) || is_queued(jobs, h))
             continue;
-        if ((int)q0arr.size() < max_procs)
-            q0arr.push(idx);
+
+        // Weighted jobs look proportionally shorter and so land higher.
+        double avg = get_avg_burst_ms(cmd_histories, jobs.history_index[h], 3) / jobs.weight[h];
+        JobClass cls = get_history_class(cmd_histories, jobs.history_index[h]);
+
+        // Wall-clock bursts overstate jobs that mostly wait on I/O, so their
+        // observed behaviour wins over the burst length; known CPU hogs skip q1.
+        int target;
+        if (cls == JOB_IO_BOUND)
+            target = 0;
+        else if (cls == JOB_CPU_BOUND && avg > (double)q0_time)
+            target = 2;
+        else if (avg > 0.0)
+            target = ((double)q0_time >= avg) ? 0 : (((double)q1_time >= avg) ? 1 : 2);
         else
+            target = 1;
+
+        // Jobs holding up DAG work start higher the longer that work is: one
+        // level for a downstream chain worth a q0 slice, two for a q1 slice.
+        double boost = critical_path_boost_ms(jobs, h);
+        int lift = boost >= (double)q1_time ? 2 : (boost >= (double)q0_time ? 1 : 0);
+        target = max(0, target - lift);
+        push_to_level(jobs, h, target);
+    }
+}
+
+static void request_handoff(int)
+{
+    handoff_requested = 1;
+}
+
+inline bool OnlineScheduler::EnableCheckpoint(const string &path)
+{
+    if (!open_checkpoint(checkpoint, path))
+        return false;
+    orphan_exits_file = orphan_exits_path(path);
+    if (checkpoint_valid(checkpoint, sizeof(CmdHistory)))
+    {
+        if (const char *why = checkpoint_records_invalid(checkpoint))
         {
-            leftover_q2.push_back(idx);  // Could not promote, keep in q1
+            // Starting over beats crashing on every restart; its jobs are not adopted.
+            cerr << "Checkpoint " << path << " is corrupt (" << why << "), starting fresh\n";
+            checkpoint_header(checkpoint)->magic = 0;
         }
+        else
+            restore_checkpoint();
     }
-    queue<int> temp2;
-    for (int idx : leftover_q2)
-        temp2.push(idx);
-    q1arr.swap(temp2);
+    job_checkpoint = &checkpoint;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = request_handoff;
+    sigaction(SIGTERM, &sa, nullptr);
 
+    save_checkpoint(now_ms());
+    return true;
 }
 
-inline bool is_queued(int idx) {
- auto in_queue = [&](queue<int> &q) {
-        queue<int> copy = q;
-        while (!copy.empty()) {
-            if (copy.front() == idx) return true;
-            copy.pop();
-        }
-        return false;
-    };
+inline void OnlineScheduler::save_checkpoint(uint64_t now)
+{
+    last_checkpoint_ms = now;
+    if (checkpoint.fd < 0)
+        return;
+
+    // Edges and command strings are append-only; only the new ones are copied.
+    vector<CheckpointEdge> new_edges;
+    for (JobHandle h = edges_saved_upto; h < jobs.size(); ++h)
+    {
+        auto it = jobs.dag.find(h);
+        if (it != jobs.dag.end())
+            for (JobHandle p : it->second.parents)
+                new_edges.push_back({p, h});
+    }
+    uint64_t arena_bytes = saved_arena_bytes;
+    for (uint32_t id = saved_commands; id < commands.size(); ++id)
+        arena_bytes += commands.length(id) + 1;
 
-    return in_queue(q0arr) || in_queue(q1arr) || in_queue(q2arr);
+    if (!reserve_checkpoint(checkpoint, jobs.size(), static_cast<uint32_t>(cmd_histories.size()),
+                            saved_edges + static_cast<uint32_t>(new_edges.size()), arena_bytes, sizeof(CmdHistory)))
+    {
+        cerr << "Checkpoint to " << checkpoint.path << " failed, disabling it\n";
+        job_checkpoint = nullptr;
+        close_checkpoint(checkpoint);
+        return;
+    }
+
+    CheckpointHeader *hd = checkpoint_header(checkpoint);
+    hd->in_progress = 1;
+    for (JobHandle h = 0; h < jobs.size(); ++h)
+        write_checkpoint_job(checkpoint, jobs, h);
+    char *hist = checkpoint_histories(checkpoint);
+    for (size_t i = 0; i < cmd_histories.size(); ++i)
+        update_checkpoint_bytes(hist + i * sizeof(CmdHistory), &cmd_histories[i], sizeof(CmdHistory));
+    if (!new_edges.empty())
+        memcpy(checkpoint_edges(checkpoint) + saved_edges, new_edges.data(), new_edges.size() * sizeof(CheckpointEdge));
+    char *arena = checkpoint_arena(checkpoint);
+    for (uint32_t id = saved_commands; id < commands.size(); ++id)
+    {
+        size_t len = commands.length(id) + 1;
+        memcpy(arena + saved_arena_bytes, commands.c_str(id), len);
+        saved_arena_bytes += len;
+    }
+
+    saved_commands = static_cast<uint32_t>(commands.size());
+    saved_edges += static_cast<uint32_t>(new_edges.size());
+    edges_saved_upto = jobs.size();
+    hd->job_count = jobs.size();
+    hd->history_count = static_cast<uint32_t>(cmd_histories.size());
+    hd->edge_count = saved_edges;
+    hd->arena_bytes = saved_arena_bytes;
+    hd->start_sec = program_start_ts.tv_sec;
+    hd->start_nsec = program_start_ts.tv_nsec;
+    hd->saved_ms = now;
+    hd->flags = 0;
+    hd->generation++;
+    hd->in_progress = 0;
+    sync_checkpoint(checkpoint);
 }
 
-static void place_new_arrivals_mlfq(vector<OnlineProcess> &proc_table,
-                                    vector<CmdHistory> &cmd_histories,
-                                    queue<int> &q0arr,
-                                    queue<int> &q1arr,
-                                    queue<int> &q2arr,
-                                    int q0_time, int q1_time, int q2_time,
-                                    const function<bool(int)> &is_queued)
+inline void OnlineScheduler::restore_checkpoint()
 {
+    uint64_t t0 = capture_clock_us(); // now_us() moves with the restored time origin
+    const CheckpointHeader hd = *checkpoint_header(checkpoint);
+    if (hd.in_progress)
+        cerr << "Checkpoint " << checkpoint.path << " was cut off mid-update; restoring what it holds\n";
+
+    const char *s = checkpoint_arena(checkpoint);
+    const char *end = s + hd.arena_bytes;
+    for (uint32_t i = 0; i < hd.history_count && s < end; ++i)
+    {
+        size_t len = strlen(s);
+        ensure_history_index(commands, cmd_histories, s, len);
+        s += len + 1;
+    }
+    const char *hist = checkpoint_histories(checkpoint);
+    for (size_t i = 0; i < cmd_histories.size(); ++i)
+        memcpy(&cmd_histories[i], hist + i * sizeof(CmdHistory), sizeof(CmdHistory));
+    if (commands.size() != hd.history_count)
+    {
+        cerr << "Checkpoint " << checkpoint.path << " is corrupt (repeated commands), starting fresh\n";
+        commands = CommandArena();
+        cmd_histories.clear();
+        checkpoint_header(checkpoint)->magic = 0;
+        return;
+    }
+    saved_commands = static_cast<uint32_t>(commands.size());
+    saved_arena_bytes = hd.arena_bytes;
+
+    if (hd.flags & CHECKPOINT_CLEAN)
+    {
+        cout << "Restored " << cmd_histories.size() << " command histories from " << checkpoint.path << "\n";
+        return;
+    }
 
+    // Keep the previous run's time origin so recorded times stay comparable.
+    program_start_ts.tv_sec = static_cast<time_t>(hd.start_sec);
+    program_start_ts.tv_nsec = static_cast<long>(hd.start_nsec);
+    restored = true;
 
-    (void)q2_time;
+    const CheckpointJob *recs = checkpoint_jobs(checkpoint);
+    for (uint32_t i = 0; i < hd.job_count; ++i)
+    {
+        const CheckpointJob &r = recs[i];
+        JobHandle h = jobs.add(r.history_index, r.metrics.arrival_time);
+        jobs.metrics[h] = r.metrics;
+        jobs.pid[h] = r.pid;
+        jobs.state[h] = r.state & static_cast<uint8_t>(~(JOB_BLOCKED | JOB_IO_WAIT));
+        jobs.total_cpu_ms[h] = r.total_cpu_ms;
+        jobs.weight[h] = r.weight;
+    }
 
-    for (int i = 0; i < (int)proc_table.size(); ++i)
+    // Dependencies: rebuild the DAG, pending counts and critical paths.
+    const CheckpointEdge *edges = checkpoint_edges(checkpoint);
+    for (uint32_t i = 0; i < hd.edge_count; ++i)
+    {
+        jobs.dag[edges[i].parent].children.push_back(edges[i].child);
+        jobs.dag[edges[i].child].parents.push_back(edges[i].parent);
+    }
+    for (auto &kv : jobs.dag)
     {
-        auto &p = proc_table[i];
-        if (p.finished)
+        DagNode &node = kv.second;
+        double est = get_avg_burst_ms(cmd_histories, jobs.history_index[kv.first], 3);
+        node.est_ms = est < 0.0 ? DEFAULT_BURST_ESTIMATE_MS : est;
+        for (JobHandle p : node.parents)
+            if (!jobs.finished(p))
+                node.pending++;
+        if (node.pending > 0 && !jobs.finished(kv.first))
+            jobs.set_state(kv.first, JOB_BLOCKED, true);
+    }
+    // Children always have larger handles than their parents.
+    for (JobHandle h = jobs.size(); h-- > 0;)
+    {
+        auto it = jobs.dag.find(h);
+        if (it == jobs.dag.end())
             continue;
-        if (is_queued(i))
+        for (JobHandle c : it->second.children)
+            it->second.downstream_ms = max(it->second.downstream_ms, jobs.dag[c].est_ms + jobs.dag[c].downstream_ms);
+    }
+    saved_edges = hd.edge_count;
+    edges_saved_upto = jobs.size();
+
+    // Live jobs: adopt the ones still running as the same process, settle
+    // the ones that exited in between, requeue everything at its old level.
+    uint64_t now = now_ms();
+    int adopted = 0, settled = 0, lost = 0;
+    for (JobHandle h = 0; h < jobs.size(); ++h)
+    {
+        if (jobs.finished(h))
             continue;
-
-        double avg = get_avg_burst_ms(cmd_histories, p.history_index, 3);
-        int target = 1;
-
-        if (avg > 0.0)
+        pid_t pid = jobs.pid[h];
+        if (pid > 0)
         {
-            if ((double)q0_time >= avg)
-                q0arr.push(i);
-            else if ((double)q1_time >= avg)
-                q1arr.push(i);
-            else
-                q2arr.push(i);
-        }
-        else
-        {
-            q1arr.push(i);
+            char state;
+            uint64_t start = 0;
+            if (!read_proc_state(pid, state, start) || start != recs[h].proc_start)
+            {
+                int status;
+                if (find_orphan_exit(orphan_exits_file, pid, status))
+                {
+                    JobMetrics &m = jobs.metrics[h];
+                    jobs.set_state(h, JOB_FINISHED, true);
+                    jobs.set_state(h, JOB_ERROR, !WIFEXITED(status) || WEXITSTATUS(status) != 0);
+                    m.completion_time = static_cast<uint32_t>(now);
+                    m.turnaround_time = m.completion_time - m.arrival_time;
+                    m.waiting_time = m.turnaround_time > jobs.total_cpu_ms[h] ? m.turnaround_time - jobs.total_cpu_ms[h] : 0;
+                    notify_job_finished(jobs, h, now);
+                    settled++;
+                }
+                else
+                {
+                    cout << "Lost job " << h << " (pid " << pid << "): " << commands.c_str(jobs.history_index[h]) << "\n";
+                    reject_process(jobs, h, now);
+                    lost++;
+                }
+                continue;
+            }
+            JobRuntime &rt = jobs.runtime(h);
+            rt.adopted = true;
+            rt.proc_start = start;
+            rt.pidfd = open_pidfd(pid);
+            if (capture_output)
+                rt.output.file_fd = open(job_output_path(static_cast<int>(h), result_prefix).c_str(), O_RDONLY | O_CLOEXEC);
+            kill(-pid, SIGSTOP);
+            adopted++;
         }
+        if (recs[h].level >= 0)
+            push_to_level(jobs, h, recs[h].level);
+    }
+
+    cout << "Restored " << jobs.size() << " jobs (" << adopted << " re-adopted, " << settled
+         << " finished meanwhile, " << lost << " lost) and " << cmd_histories.size()
+         << " command histories from " << checkpoint.path << " in "
+         << (capture_clock_us() - t0) / 1000.0 << " ms\n";
+}
+
+// Periodic checkpoint, and the hand-off to a new instance on SIGTERM.
+inline void OnlineScheduler::checkpoint_tick(uint64_t now)
+{
+    if (checkpoint.fd < 0)
+        return;
+    if (handoff_requested)
+    {
+        save_checkpoint(now);
+        cout << "Checkpointed " << jobs.size() << " jobs to " << checkpoint.path << ", handing off\n";
+        job_checkpoint = nullptr;
+        close_checkpoint(checkpoint);
+        cout.flush();
+        exit(SCHED_RESTART_EXIT);
     }
+    if (now - last_checkpoint_ms >= CHECKPOINT_INTERVAL_MS)
+        save_checkpoint(now);
 }
 
+// A job gets its record before it is forked: a crash before the next
+// periodic checkpoint must not leave its stopped child unknown.
+inline void OnlineScheduler::checkpoint_before_spawn(JobHandle h)
+{
+    if (checkpoint.fd >= 0 && (!checkpoint.map || h >= checkpoint_header(checkpoint)->job_count))
+        save_checkpoint(now_ms());
+}
 
-void OnlineScheduler::MultiLevelFeedbackQueue(int quantum0, int quantum1, int quantum2, int boostTime)
+// Final checkpoint; marked clean when nothing is left to re-adopt, so the
+// next start only takes the command histories.
+inline void OnlineScheduler::finish_checkpoint()
 {
-    set_program_start_time();
+    if (checkpoint.fd < 0)
+        return;
+    save_checkpoint(now_ms());
+    bool done = true;
+    for (JobHandle h = 0; h < jobs.size() && done; ++h)
+        done = jobs.finished(h);
+    if (done && checkpoint.map)
+    {
+        checkpoint_header(checkpoint)->flags |= CHECKPOINT_CLEAN;
+        unlink(orphan_exits_file.c_str());
+    }
+    job_checkpoint = nullptr;
+    close_checkpoint(checkpoint);
+}
+
+inline void OnlineScheduler::MultiLevelFeedbackQueue(int quantum0, int quantum1, int quantum2, int boostTime)
+{
+    if (!restored)
+        set_program_start_time();
     set_stdin_nonblocking(true);
+    if (kernel_priorities)
+        raise_scheduler_priority();
 
-    // queue<int> q0, q1, q2;
+    ofstream csv(result_prefix + "result_online_MLFQ.csv");
+    csv << ONLINE_CSV_HEADER;
 
     int q[3] = {quantum0, quantum1, quantum2};
-    poll_and_enqueue_new_commands(proc_table, cmd_histories, now_ms());
+    poll_submissions();
     uint64_t last_boost = now_ms();
+    tuner.last_tune_ms = last_boost;
+    vector<double> burst_samples;
+    // Time the previous preemption's stop_job took; added to the next
+    // SIGCONT to give one switch cost. 0 when the last slice did not end in
+    // a stop, so spawning, idling and bookkeeping never count as overhead.
+    uint64_t last_stop_us = 0;
+    vector<JobHandle> io_waiters;
+    auto unfinished = [&]() {
+        int n = 0;
+        for (JobHandle h = 0; h < jobs.size(); ++h)
+            if (!jobs.finished(h))
+                n++;
+        return n;
+    };
 
 
     while (true) {
-        poll_and_enqueue_new_commands(proc_table, cmd_histories, now_ms());
-        place_new_arrivals_mlfq(proc_table, cmd_histories, q0arr, q1arr, q2arr, q[0], q[1], q[2], is_queued);
+        // Every live job is stopped and queued here, or asleep in
+        // io_waiters, so this is where a checkpoint or hand-off captures a
+        // consistent picture.
+        checkpoint_tick(now_ms());
+        poll_submissions();
+        wake_io_waiters(jobs, io_waiters, csv, commands, cmd_histories);
+        place_new_arrivals_mlfq(jobs, cmd_histories, q[0], q[1]);
 
         uint64_t cur = now_ms();
 
+        if (tuner.enabled && (cur - tuner.last_tune_ms) >= TUNE_INTERVAL_MS) {
+            collect_recent_bursts(cmd_histories, 0, burst_samples);
+            tune_quanta(tuner, burst_samples, q, boostTime, cur);
+        }
+
         // Priority Boost
         if (boostTime > 0 && (cur - last_boost) >= static_cast<uint64_t>(boostTime)) {
-            promote_all_to_q0(q0arr, q1arr, q2arr, MAX_PROCS, is_queued);
+            promote_all_to_q0(jobs, MAX_PROCS);
             last_boost = cur;
             cout << "Priority boost at " << last_boost << "\n";
         }
@@ -535,18 +1517,9 @@ void OnlineScheduler::MultiLevelFeedbackQueue(int quantum0, int quantum1, int qu
         else if (!q1arr.empty()) pick_q = 1;
         else if (!q2arr.empty()) pick_q = 2;
         else {
-            if (count_if(proc_table.begin(), proc_table.end(), [](const OnlineProcess &p) { return !p.finished; }) == 0) {
-                fd_set rfds;
-                while (count_if(proc_table.begin(), proc_table.end(), [](const OnlineProcess &p) { return !p.finished; }) == 0) {
-                    FD_ZERO(&rfds);
-                    FD_SET(STDIN_FILENO, &rfds);
-                    int sel = select(STDIN_FILENO + 1, &rfds, nullptr, nullptr, nullptr);
-                    if (sel > 0) {
-                        poll_and_enqueue_new_commands(proc_table, cmd_histories, now_ms());
-                        place_new_arrivals_mlfq(proc_table, cmd_histories, q0arr, q1arr, q2arr, q[0], q[1], q[2], is_queued);
-                        break;
-                    } else if (sel == -1 && errno == EINTR) continue;
-                }
+            if (unfinished() == 0) {
+                if (!wait_for_submissions())
+                    break;
                 continue;
             } else {
                 struct timespec ts{0, POLL_SLEEP_MS * 1000000L};
@@ -555,50 +1528,85 @@ void OnlineScheduler::MultiLevelFeedbackQueue(int quantum0, int quantum1, int qu
             }
         }
 
-        int proc_idx = -1;
-        if (pick_q == 0 && !q0arr.empty()) { proc_idx = q0arr.front(); q0arr.pop(); }
-        else if (pick_q == 1 && !q1arr.empty()) { proc_idx = q1arr.front(); q1arr.pop(); }
-        else if (pick_q == 2 && !q2arr.empty()) { proc_idx = q2arr.front(); q2arr.pop(); }
-        while (proc_idx >= 0 && proc_table[proc_idx].finished) {
-            if (pick_q == 0 && !q0arr.empty()) { proc_idx = q0arr.front(); q0arr.pop(); }
-            else if (pick_q == 1 && !q1arr.empty()) { proc_idx = q1arr.front(); q1arr.pop(); }
-            else if (pick_q == 2 && !q2arr.empty()) { proc_idx = q2arr.front(); q2arr.pop(); }
-        }
+        int proc_idx = pop_from_level(jobs, pick_q);
+        while (proc_idx >= 0 && jobs.finished(proc_idx))
+            proc_idx = pop_from_level(jobs, pick_q);
 
         if (proc_idx < 0) continue;
-        auto &p = proc_table[proc_idx];
-
-        if (p.pid == -1) {
-            spawn_and_stop_child(p);
-            if(p.pid <= 0) {
-                p.finished = true;
-                p.error = true;
-                p.completion_time = now_ms();
-                
-            continue;
+        JobHandle job = static_cast<JobHandle>(proc_idx);
+        const char *command = commands.c_str(jobs.history_index[job]);
+
+        if (jobs.pid[job] == -1) {
+            AdmissionDecision gate = admit_new_start(admission, count_live_children(jobs), now_ms());
+            if (gate == SHED) {
+                jobs.set_state(job, JOB_ERROR, true);
+                complete_process(jobs, job, now_ms(), false, 0, csv, commands, cmd_histories);
+                admission.shed_jobs++;
+                cout << "Admission shed: " << command << "\n";
+                continue;
+            }
+            if (gate == THROTTLE) {
+                // Keep it queued and give the slice to a job that already runs.
+                push_to_level(jobs, job, pick_q);
+                proc_idx = -1;
+                for (pick_q = 0; pick_q < 3 && proc_idx < 0; ++pick_q)
+                    proc_idx = pop_first_started(jobs, pick_q);
+                pick_q--;
+                if (proc_idx < 0) {
+                    struct timespec ts{0, POLL_SLEEP_MS * 1000000L};
+                    nanosleep(&ts, nullptr);
+                    continue;
+                }
+                job = static_cast<JobHandle>(proc_idx);
+                command = commands.c_str(jobs.history_index[job]);
+            }
         }
+
+        if (jobs.pid[job] == -1) {
+            checkpoint_before_spawn(job);
+            spawn_and_stop_child(jobs, job, command, capture_output ? job_output_path(proc_idx, result_prefix) : "");
+            if(jobs.pid[job] <= 0) {
+                reject_process(jobs, job, now_ms());
+                continue;
+            }
         }
 
+        // Polling below only adds descriptors; no other job takes a runtime
+        // slot during this slice, so rt stays valid.
+        JobRuntime &rt = jobs.runtime(job);
+        pid_t pid = jobs.pid[job];
+        int kernel_level = (pick_q == 2 && rt.job_class == JOB_CPU_BOUND) ? KPRIO_BACKGROUND : pick_q;
+        if (kernel_priorities && rt.kernel_level != kernel_level && apply_kernel_priority(pid, kernel_level))
+            rt.kernel_level = kernel_level;
+
         uint64_t start = now_ms();
-        if (!p.started) {
-            kill(-p.pid, SIGCONT);
-            p.started = true;
-            p.response_time = start - p.arrival_time;
-        } else {
-            kill(-p.pid, SIGCONT);
+        uint64_t cont_start_us = now_us();
+        kill(-pid, SIGCONT);
+        uint64_t cont_us = now_us();
+        if (last_stop_us > 0)
+            record_switch_cost(tuner, last_stop_us + (cont_us - cont_start_us));
+        last_stop_us = 0;
+        if (!jobs.started(job)) {
+            jobs.set_state(job, JOB_STARTED, true);
+            jobs.metrics[job].response_time = static_cast<uint32_t>(start) - jobs.metrics[job].arrival_time;
         }
 
-        p.slice_start_ms = start;
+        jobs.metrics[job].slice_start_ms = static_cast<uint32_t>(start);
+        rt.slice_sample = read_proc_sample(pid, start);
+        rt.last_sample = rt.slice_sample;
         int slice_len_ms = q[pick_q];
 
-        double est = get_avg_burst_ms(cmd_histories, p.history_index, 3);
-        if (est > 0.0) {
-            double rem_est = est - static_cast<double>(p.total_cpu_time);
+        // Trimming the slice to the predicted remainder only makes sense for
+        // jobs whose wall time is CPU time; I/O-bound jobs keep the full quantum.
+        double est = get_avg_burst_ms(cmd_histories, jobs.history_index[job], 3);
+        if (est > 0.0 && rt.job_class != JOB_IO_BOUND) {
+            double rem_est = est - static_cast<double>(jobs.total_cpu_ms[job]);
             if (rem_est <= 0.0) slice_len_ms = POLL_SLEEP_MS;
             else slice_len_ms = std::max(POLL_SLEEP_MS, static_cast<int>(std::min(rem_est, (double)slice_len_ms)));
         }
 
         bool finished_in_slice = false;
+        bool blocked = false;
         int elapsed = 0;
 
         while (elapsed < slice_len_ms) {
@@ -606,37 +1614,84 @@ void OnlineScheduler::MultiLevelFeedbackQueue(int quantum0, int quantum1, int qu
             struct timespec ts{0, to_sleep * 1000000L};
             nanosleep(&ts, nullptr);
             elapsed += to_sleep;
-            poll_and_enqueue_new_commands(proc_table, cmd_histories, now_ms());
+            poll_submissions();
+            command = commands.c_str(jobs.history_index[job]);
+
+            // Sample before reaping: /proc/<pid> disappears with the zombie.
+            ProcSample tick = read_proc_sample(pid, now_ms());
+            uint64_t prev_cpu_ms = rt.last_sample.cpu_ms;
+            if (tick.valid)
+                rt.last_sample = tick;
 
+            drain_output_capture(rt.output);
             int wstatus = 0;
-            int r = check_child_exited(p.pid, &wstatus);
-            if (r > 0 || r == -1) {
+            if (job_exited(jobs, job, &wstatus)) {
                 uint64_t end = now_ms();
-                uint64_t ran = end - start;
-                p.total_cpu_time += ran;
-                p.error = (r == -1);
+                record_behavior_to_history(cmd_histories, jobs.history_index[job],
+                    diff_proc_samples(rt.slice_sample, rt.last_sample, rt.last_sample.taken_ms - start));
+                jobs.total_cpu_ms[job] += static_cast<uint32_t>(end - start);
+                record_slice_time(tuner, now_us() - cont_us);
+                complete_process(jobs, job, end, true, wstatus, csv, commands, cmd_histories);
                 finished_in_slice = true;
                 break;
             }
 
+            // Asleep or waiting on I/O with no CPU progress since the last
+            // tick: give the CPU to the next job instead of idling out the slice.
+            if (tick.valid && tick.cpu_ms == prev_cpu_ms && is_sleeping_state(tick.state) &&
+                proc_descendants_sleeping(pid)) {
+                blocked = true;
+                break;
+            }
+
+            wake_io_waiters(jobs, io_waiters, csv, commands, cmd_histories);
             if (pick_q > 0 && ((pick_q == 1 && !q0arr.empty()) || (pick_q == 2 && (!q0arr.empty() || !q1arr.empty()))))
                 break;
         }
+        uint64_t slice_end_us = now_us();
 
         if (!finished_in_slice) {
             uint64_t end = now_ms();
             uint64_t ran = end - start;
             int wstatus = 0;
-            p.total_cpu_time += ran;
-            kill(-p.pid, SIGSTOP);
-            print_context_switch(p.command, start, end);
-            if (elapsed >= slice_len_ms)
-                (pick_q < 2 ? q1arr : q2arr).push(proc_idx);
-            else
-                (pick_q == 0 ? q0arr : (pick_q == 1 ? q1arr : q2arr)).push(proc_idx);
+            jobs.total_cpu_ms[job] += static_cast<uint32_t>(ran);
+            record_slice_time(tuner, slice_end_us - cont_us);
+            ProcBehavior behavior = diff_proc_samples(rt.slice_sample, read_proc_sample(pid, end), end - start);
+            uint64_t stop_start_us = now_us();
+            int stopped = blocked ? 1 : stop_job(jobs, job, &wstatus);
+            if (!blocked && stopped == 1)
+                last_stop_us = max<uint64_t>(1, now_us() - stop_start_us);
+            record_behavior_to_history(cmd_histories, jobs.history_index[job], behavior);
+            if (behavior.valid)
+                rt.job_class = classify_behavior(behavior);
+            if (blocked) {
+                // Left running; it rejoins this level once it can use the CPU.
+                print_context_switch(command, start, end);
+                rt.io_wait_level = pick_q;
+                jobs.set_state(job, JOB_IO_WAIT, true);
+                io_waiters.push_back(job);
+                continue;
+            }
+            if (stopped != 1) {
+                complete_process(jobs, job, end, stopped == 0, wstatus, csv, commands, cmd_histories);
+                continue;
+            }
+            drain_output_capture(rt.output);
+            print_context_switch(command, start, end);
+            int next_q = pick_q;
+            if (elapsed >= slice_len_ms) {
+                // Used its whole quantum without blocking: CPU hogs drop
+                // straight to the bottom, the rest one level.
+                if (rt.job_class == JOB_CPU_BOUND)
+                    next_q = 2;
+                else
+                    next_q = std::min(pick_q + 1, 2);
+            }
+            push_to_level(jobs, job, next_q);
         }
     }
 
-    write_results_to_csv(proc_table, "result_online_MLFQ.csv");
+    write_results_to_csv(jobs, commands, result_prefix + "result_online_MLFQ.csv");
+    print_admission_summary(admission, "MLFQ");
     set_stdin_nonblocking(false);
-}
\ No newline at end of file
+}
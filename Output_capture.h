@@ -0,0 +1,150 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <ctime>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+#define JOB_OUTPUT_DIR "job_output"
+#define CAPTURE_PIPE_SIZE (1 << 20) // room for a chatty job between two poll ticks
+#define SPLICE_CHUNK (1 << 16)
+
+// A job's stdout+stderr pipe and the file its bytes are spliced into.
+struct OutputCapture
+{
+    int pipe_rd = -1;
+    int pipe_wr = -1;
+    int file_fd = -1;
+    uint64_t bytes = 0;
+    uint64_t splice_us = 0; // scheduler time spent moving the bytes
+};
+
+static uint64_t capture_clock_us()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return static_cast<uint64_t>(t.tv_sec) * 1000000ULL + static_cast<uint64_t>(t.tv_nsec) / 1000ULL;
+}
+
+// prefix keeps schedulers that share a directory (shards) apart.
+inline string job_output_path(int job_idx, const string &prefix = "")
+{
+    return string(JOB_OUTPUT_DIR) + "/" + prefix + to_string(job_idx) + ".log";
+}
+
+// Creates the pipe and output file before fork. Both pipe ends are
+// close-on-exec so no other job inherits them. With direct, the job writes
+// straight into the file instead, so it does not depend on the scheduler
+// staying alive to drain a pipe (checkpointed runs).
+inline bool open_output_capture(OutputCapture &c, const string &path, bool direct = false)
+{
+    mkdir(JOB_OUTPUT_DIR, 0755);
+    if (direct)
+    {
+        c.pipe_wr = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+        if (c.pipe_wr == -1)
+            return false;
+        c.file_fd = fcntl(c.pipe_wr, F_DUPFD_CLOEXEC, 0); // kept to size the output
+        return true;
+    }
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1)
+        return false;
+    c.file_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (c.file_fd == -1)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    fcntl(fds[0], F_SETPIPE_SZ, CAPTURE_PIPE_SIZE);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    c.pipe_rd = fds[0];
+    c.pipe_wr = fds[1];
+    return true;
+}
+
+// Child side, between fork and exec.
+inline void attach_output_capture(const OutputCapture &c)
+{
+    if (c.pipe_wr < 0)
+        return;
+    dup2(c.pipe_wr, STDOUT_FILENO);
+    dup2(c.pipe_wr, STDERR_FILENO);
+}
+
+// Parent side, right after fork: only the child may hold the write end, so
+// the read end sees EOF once the job and its helpers are gone.
+inline void release_capture_writer(OutputCapture &c)
+{
+    if (c.pipe_wr >= 0)
+    {
+        close(c.pipe_wr);
+        c.pipe_wr = -1;
+    }
+}
+
+// Moves whatever is buffered in the pipe into the file without copying it
+// through userspace. Returns false once the pipe reached EOF.
+inline bool drain_output_capture(OutputCapture &c)
+{
+    if (c.pipe_rd < 0)
+        return false;
+    uint64_t start = capture_clock_us();
+    bool open_end = true;
+    while (true)
+    {
+        ssize_t n = splice(c.pipe_rd, nullptr, c.file_fd, nullptr, SPLICE_CHUNK,
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0)
+        {
+            c.bytes += static_cast<uint64_t>(n);
+            continue;
+        }
+        if (n == 0)
+            open_end = false;
+        else if (errno == EINTR)
+            continue;
+        else if (errno == EINVAL)
+        {
+            // Target file system without splice support: plain copy.
+            char buf[SPLICE_CHUNK];
+            ssize_t r;
+            while ((r = read(c.pipe_rd, buf, sizeof(buf))) > 0)
+            {
+                if (write(c.file_fd, buf, static_cast<size_t>(r)) == r)
+                    c.bytes += static_cast<uint64_t>(r);
+            }
+            open_end = (r != 0);
+        }
+        break;
+    }
+    c.splice_us += capture_clock_us() - start;
+    return open_end;
+}
+
+inline void close_output_capture(OutputCapture &c)
+{
+    struct stat st;
+    if (c.pipe_rd < 0 && c.file_fd >= 0 && fstat(c.file_fd, &st) == 0)
+        c.bytes = static_cast<uint64_t>(st.st_size);
+    drain_output_capture(c);
+    release_capture_writer(c);
+    if (c.pipe_rd >= 0)
+        close(c.pipe_rd);
+    if (c.file_fd >= 0)
+        close(c.file_fd);
+    c.pipe_rd = c.file_fd = -1;
+}
+
+// Rate at which the job produced output while it was running.
+inline double output_kbps(uint64_t bytes, uint64_t run_ms)
+{
+    if (run_ms == 0)
+        return 0.0;
+    return static_cast<double>(bytes) / static_cast<double>(run_ms);
+}
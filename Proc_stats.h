@@ -0,0 +1,243 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/types.h>
+
+using namespace std;
+
+#define IO_BOUND_CPU_RATIO 0.3  // below this share of wall time on CPU a slice counts as I/O-bound
+#define CPU_HOG_CPU_RATIO 0.8   // above this share (with mostly forced switches) it is a CPU hog
+#define MIN_SAMPLE_WINDOW_MS 10 // shorter windows are too coarse for the tick-based counters
+
+enum JobClass
+{
+    JOB_UNKNOWN = 0,
+    JOB_IO_BOUND,
+    JOB_MIXED,
+    JOB_CPU_BOUND
+};
+
+// Counters read from /proc/<pid>/status and /proc/<pid>/stat at one instant.
+struct ProcSample
+{
+    bool valid = false;
+    char state = 0;          // R, S, D, ... as in /proc/<pid>/stat
+    uint64_t taken_ms = 0;
+    uint64_t voluntary_switches = 0;
+    uint64_t involuntary_switches = 0;
+    uint64_t cpu_ms = 0;     // utime + stime
+    uint64_t blkio_ms = 0;   // delayacct_blkio_ticks, 0 unless delay accounting is on
+};
+
+// What a job did between two samples.
+struct ProcBehavior
+{
+    bool valid = false;
+    double cpu_ratio = 0.0;      // CPU time / wall time
+    double voluntary_share = 0.0; // voluntary / all context switches
+    uint64_t blkio_ms = 0;
+};
+
+static uint64_t clock_ticks_to_ms(uint64_t ticks)
+{
+    static long hz = sysconf(_SC_CLK_TCK);
+    return hz > 0 ? ticks * 1000 / static_cast<uint64_t>(hz) : ticks * 10;
+}
+
+// Pids of the processes pid forked (its main thread's children); false
+// where the kernel has no children list (CONFIG_PROC_CHILDREN off).
+static bool read_proc_children(pid_t pid, vector<int> &out)
+{
+    out.clear();
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/children", static_cast<int>(pid), static_cast<int>(pid));
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return false;
+    int child;
+    while (fscanf(f, "%d", &child) == 1)
+        out.push_back(child);
+    fclose(f);
+    return true;
+}
+
+// Adds one process's counters to s (in clock ticks for the CPU fields).
+// cutime/cstime are included: a child's time moves there when it is reaped,
+// so the sum over a live tree keeps growing as its processes come and go.
+static bool add_proc_counters(pid_t pid, ProcSample &s, char *state)
+{
+    char path[64];
+    char buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", static_cast<int>(pid));
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return false;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+
+    // comm may contain spaces and parentheses; the fields start after the last ')'.
+    char *rest = strrchr(buf, ')');
+    if (!rest || rest[1] == '\0')
+        return false;
+    rest += 2;
+    if (state)
+        *state = rest[0];
+    int field = 3;
+    for (char *tok = strtok(rest, " "); tok; tok = strtok(nullptr, " "), ++field)
+    {
+        if (field >= 14 && field <= 17) // utime, stime, cutime, cstime
+            s.cpu_ms += strtoull(tok, nullptr, 10);
+        else if (field == 42)
+        {
+            s.blkio_ms += strtoull(tok, nullptr, 10);
+            break;
+        }
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/status", static_cast<int>(pid));
+    f = fopen(path, "r");
+    if (!f)
+        return true;
+    char line[256];
+    while (fgets(line, sizeof(line), f))
+    {
+        if (strncmp(line, "voluntary_ctxt_switches:", 24) == 0)
+            s.voluntary_switches += strtoull(line + 24, nullptr, 10);
+        else if (strncmp(line, "nonvoluntary_ctxt_switches:", 27) == 0)
+            s.involuntary_switches += strtoull(line + 27, nullptr, 10);
+    }
+    fclose(f);
+    return true;
+}
+
+static void add_descendant_counters(pid_t pid, ProcSample &s, int depth)
+{
+    vector<int> children;
+    if (depth > 8 || !read_proc_children(pid, children))
+        return;
+    for (int c : children)
+        if (add_proc_counters(c, s, nullptr))
+            add_descendant_counters(c, s, depth + 1);
+}
+
+// Counters of a job: pid (usually the `sh -c` wrapper) plus everything it
+// forked, so the work done by the actual command is what gets classified.
+// state is pid's own.
+inline ProcSample read_proc_sample(pid_t pid, uint64_t now)
+{
+    ProcSample s;
+    if (!add_proc_counters(pid, s, &s.state))
+        return s;
+    add_descendant_counters(pid, s, 0);
+    s.cpu_ms = clock_ticks_to_ms(s.cpu_ms);
+    s.blkio_ms = clock_ticks_to_ms(s.blkio_ms);
+    s.taken_ms = now;
+    s.valid = true;
+    return s;
+}
+
+// State letter of one process; 0 if it is gone.
+static char read_proc_state_letter(pid_t pid)
+{
+    char path[64], buf[512];
+    snprintf(path, sizeof(path), "/proc/%d/stat", static_cast<int>(pid));
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+    char *rest = strrchr(buf, ')');
+    return (rest && rest[1] == ' ') ? rest[2] : 0;
+}
+
+inline bool is_sleeping_state(char state)
+{
+    return state == 'S' || state == 'D';
+}
+
+// True if nothing in the tree below pid can run: every descendant is asleep,
+// in I/O or a zombie. A shell waiting on a busy pipeline is not blocked.
+inline bool proc_descendants_sleeping(pid_t pid, int depth = 0)
+{
+    vector<int> children;
+    if (depth > 8 || !read_proc_children(pid, children))
+        return true; // no children list: judge by pid alone
+    for (int child : children)
+    {
+        char st = read_proc_state_letter(child);
+        if (st != 0 && st != 'Z' && !(is_sleeping_state(st) && proc_descendants_sleeping(child, depth + 1)))
+            return false;
+    }
+    return true;
+}
+
+inline ProcBehavior diff_proc_samples(const ProcSample &from, const ProcSample &to, uint64_t wall_ms)
+{
+    ProcBehavior b;
+    if (!from.valid || !to.valid || wall_ms < MIN_SAMPLE_WINDOW_MS)
+        return b;
+    uint64_t cpu = to.cpu_ms > from.cpu_ms ? to.cpu_ms - from.cpu_ms : 0;
+    uint64_t vol = to.voluntary_switches - from.voluntary_switches;
+    uint64_t invol = to.involuntary_switches - from.involuntary_switches;
+    b.cpu_ratio = min(1.0, static_cast<double>(cpu) / static_cast<double>(wall_ms));
+    b.voluntary_share = (vol + invol) ? static_cast<double>(vol) / static_cast<double>(vol + invol) : 0.0;
+    b.blkio_ms = to.blkio_ms > from.blkio_ms ? to.blkio_ms - from.blkio_ms : 0;
+    b.valid = true;
+    return b;
+}
+
+inline JobClass classify_behavior(double cpu_ratio, double voluntary_share, uint64_t blkio_ms)
+{
+    if (cpu_ratio < IO_BOUND_CPU_RATIO && (voluntary_share >= 0.5 || blkio_ms > 0))
+        return JOB_IO_BOUND;
+    if (cpu_ratio > CPU_HOG_CPU_RATIO && voluntary_share < 0.5)
+        return JOB_CPU_BOUND;
+    return JOB_MIXED;
+}
+
+inline JobClass classify_behavior(const ProcBehavior &b)
+{
+    if (!b.valid)
+        return JOB_UNKNOWN;
+    return classify_behavior(b.cpu_ratio, b.voluntary_share, b.blkio_ms);
+}
+
+// Pressure stall information from /proc/pressure/<resource>
+// (cpu, memory or io): share of the last 10s some or all tasks stalled.
+struct PsiReading
+{
+    bool valid = false;
+    double some_avg10 = 0.0;
+    double full_avg10 = 0.0;
+};
+
+inline PsiReading read_psi(const char *resource)
+{
+    PsiReading r;
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/pressure/%s", resource);
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return r;
+    char line[256];
+    while (fgets(line, sizeof(line), f))
+    {
+        double avg10 = 0.0;
+        if (sscanf(line, "some avg10=%lf", &avg10) == 1)
+        {
+            r.some_avg10 = avg10;
+            r.valid = true;
+        }
+        else if (sscanf(line, "full avg10=%lf", &avg10) == 1)
+            r.full_avg10 = avg10;
+    }
+    fclose(f);
+    return r;
+}
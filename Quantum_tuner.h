@@ -0,0 +1,122 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+#define TUNE_INTERVAL_MS 1000     // how often the controller re-evaluates the quanta
+#define TUNE_SMOOTHING 0.5        // weight of the new target in each adjustment step
+#define TUNE_MIN_BURST_SAMPLES 4  // bursts needed before the distribution is trusted
+
+// Bounds the feedback controller is allowed to move the MLFQ parameters within.
+struct QuantumBounds
+{
+    int min_quantum_ms = 20;
+    int max_quantum_ms = 8000;
+    int min_boost_ms = 500;
+    int max_boost_ms = 30000;
+    double target_overhead = 0.02; // switch cost / (slice + switch cost)
+};
+
+struct QuantumTuner
+{
+    QuantumBounds bounds;
+    bool enabled = false;
+    double switch_cost_us = 0.0; // EWMA of stopping one job plus continuing the next
+    uint64_t switch_samples = 0;
+    uint64_t total_switch_us = 0;
+    uint64_t total_slice_us = 0;
+    uint64_t last_tune_ms = 0;
+};
+
+inline void record_switch_cost(QuantumTuner &t, uint64_t gap_us)
+{
+    if (t.switch_samples == 0)
+        t.switch_cost_us = static_cast<double>(gap_us);
+    else
+        t.switch_cost_us = 0.8 * t.switch_cost_us + 0.2 * static_cast<double>(gap_us);
+    t.switch_samples++;
+    t.total_switch_us += gap_us;
+}
+
+inline void record_slice_time(QuantumTuner &t, uint64_t slice_us)
+{
+    t.total_slice_us += slice_us;
+}
+
+inline double burst_percentile(const vector<double> &sorted, double pct)
+{
+    if (sorted.empty())
+        return -1.0;
+    size_t idx = static_cast<size_t>(pct * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[min(idx, sorted.size() - 1)];
+}
+
+static int clamp_ms(double v, int lo, int hi)
+{
+    if (v < lo)
+        return lo;
+    if (v > hi)
+        return hi;
+    return static_cast<int>(v + 0.5);
+}
+
+// One controller step. Each level gets at least the quantum that keeps the
+// measured switch cost under the overhead target; above that floor q0 covers
+// the median burst, q1 the 90th and q2 the 99th percentile, so most short jobs
+// finish without being preempted. The boost interval follows the quanta so a
+// q2 job still gets a couple of full slices between boosts.
+// Returns true (and logs the new values) when anything changed.
+inline bool tune_quanta(QuantumTuner &t, vector<double> bursts, int q[3], int &boost_ms, uint64_t now)
+{
+    t.last_tune_ms = now;
+    if (!t.enabled || t.switch_samples == 0)
+        return false;
+
+    const QuantumBounds &b = t.bounds;
+    double cost_ms = t.switch_cost_us / 1000.0;
+    double floor_ms = cost_ms * (1.0 - b.target_overhead) / b.target_overhead;
+
+    double want[3] = {static_cast<double>(q[0]), static_cast<double>(q[1]), static_cast<double>(q[2])};
+    if (static_cast<int>(bursts.size()) >= TUNE_MIN_BURST_SAMPLES)
+    {
+        sort(bursts.begin(), bursts.end());
+        want[0] = burst_percentile(bursts, 0.50);
+        want[1] = burst_percentile(bursts, 0.90);
+        want[2] = max(burst_percentile(bursts, 0.99), 2.0 * want[1]);
+    }
+
+    int next[3];
+    int lo = max(b.min_quantum_ms, clamp_ms(floor_ms, b.min_quantum_ms, b.max_quantum_ms));
+    for (int i = 0; i < 3; ++i)
+    {
+        double target = max(want[i], static_cast<double>(lo));
+        double step = q[i] + TUNE_SMOOTHING * (target - q[i]);
+        next[i] = clamp_ms(step, lo, b.max_quantum_ms);
+        if (i > 0 && next[i] < next[i - 1])
+            next[i] = next[i - 1];
+    }
+    int next_boost = clamp_ms(2.0 * (next[0] + next[1] + next[2]), b.min_boost_ms, b.max_boost_ms);
+
+    bool changed = next_boost != boost_ms;
+    for (int i = 0; i < 3; ++i)
+        changed = changed || next[i] != q[i];
+    if (!changed)
+        return false;
+
+    for (int i = 0; i < 3; ++i)
+        q[i] = next[i];
+    boost_ms = next_boost;
+
+    uint64_t busy = t.total_switch_us + t.total_slice_us;
+    double overhead_pct = busy ? 100.0 * static_cast<double>(t.total_switch_us) / static_cast<double>(busy) : 0.0;
+    cout << "Adaptive quanta at " << now
+         << ": q0=" << q[0] << " q1=" << q[1] << " q2=" << q[2]
+         << " boost=" << boost_ms
+         << " | switch=" << static_cast<uint64_t>(t.switch_cost_us) << "us"
+         << " overhead=" << overhead_pct << "%"
+         << " bursts=" << bursts.size() << "\n";
+    return true;
+}
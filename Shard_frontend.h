@@ -0,0 +1,520 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <sched.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "Online_scheduler.h"
+
+using namespace std;
+
+// Front end for several OnlineScheduler shards on one box. Each shard is a
+// forked process pinned to a NUMA node (or CPU set) whose stdin is one end
+// of a socketpair; the front end writes submissions to it and reads
+// completion lines back from the same socket. The front end's ends are
+// non-blocking: a shard busy running a job (SJF reads nothing meanwhile) only
+// grows its outbox instead of stalling routing for the others.
+
+#define SHARD_AFFINITY_SLACK 2 // outstanding jobs a warm shard may carry over the least loaded one
+#define SHARD_MAX 64
+
+enum ShardPolicy
+{
+    SHARD_SJF = 0,
+    SHARD_MLFQ
+};
+
+struct ShardConfig
+{
+    int shards = 2;
+    ShardPolicy policy = SHARD_MLFQ;
+    vector<string> cpu_lists; // explicit CPU sets ("0-3"), one per shard; empty = NUMA nodes
+    int sjf_k = 3;
+    int quanta[4] = {500, 1000, 2000, 4000};
+};
+
+struct Shard
+{
+    pid_t pid = -1;
+    int sock = -1;
+    cpu_set_t cpus;
+    string cpu_desc;
+    bool writable = true;
+    bool closed = false;
+    uint64_t routed = 0, completed = 0, errors = 0, affinity_hits = 0;
+    vector<double> turnaround_ms, response_ms;
+    string partial; // unterminated completion line
+    string outbox;  // routed submissions the socket has not taken yet
+};
+
+// Parses a kernel cpulist such as "0-3,8,10-11".
+inline bool parse_cpu_list(const string &list, cpu_set_t &set)
+{
+    CPU_ZERO(&set);
+    const char *p = list.c_str();
+    int count = 0;
+    while (*p)
+    {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p)
+            break;
+        long hi = lo;
+        p = end;
+        if (*p == '-')
+        {
+            hi = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long c = lo; c <= hi && c < CPU_SETSIZE; ++c, ++count)
+            CPU_SET(static_cast<int>(c), &set);
+        while (*p == ',' || *p == '\n' || *p == ' ')
+            ++p;
+    }
+    return count > 0;
+}
+
+// CPU lists of the NUMA nodes that have CPUs, in node order.
+inline vector<string> numa_node_cpu_lists()
+{
+    vector<pair<int, string>> nodes;
+    DIR *d = opendir("/sys/devices/system/node");
+    if (!d)
+        return {};
+    while (struct dirent *e = readdir(d))
+    {
+        if (strncmp(e->d_name, "node", 4) != 0 || !isdigit(static_cast<unsigned char>(e->d_name[4])))
+            continue;
+        string path = string("/sys/devices/system/node/") + e->d_name + "/cpulist";
+        ifstream in(path);
+        string list;
+        if (getline(in, list) && !list.empty())
+            nodes.emplace_back(atoi(e->d_name + 4), list);
+    }
+    closedir(d);
+    sort(nodes.begin(), nodes.end());
+    vector<string> lists;
+    for (auto &n : nodes)
+        lists.push_back(n.second);
+    return lists;
+}
+
+// Assigns each shard a CPU set: the explicit lists if given, else NUMA nodes
+// round-robin when there are at least as many nodes as shards, else the
+// allowed CPUs split into contiguous chunks.
+inline void assign_shard_cpus(const ShardConfig &cfg, vector<Shard> &shards)
+{
+    vector<string> lists = cfg.cpu_lists.empty() ? numa_node_cpu_lists() : cfg.cpu_lists;
+    if (!lists.empty() && (!cfg.cpu_lists.empty() || lists.size() >= shards.size()))
+    {
+        for (size_t i = 0; i < shards.size(); ++i)
+        {
+            shards[i].cpu_desc = lists[i % lists.size()];
+            if (!parse_cpu_list(shards[i].cpu_desc, shards[i].cpus))
+                cerr << "Bad CPU list " << shards[i].cpu_desc << "\n";
+        }
+        return;
+    }
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    vector<int> cpus;
+    for (int c = 0; c < CPU_SETSIZE; ++c)
+        if (CPU_ISSET(c, &allowed))
+            cpus.push_back(c);
+    for (size_t i = 0; i < shards.size(); ++i)
+    {
+        CPU_ZERO(&shards[i].cpus);
+        size_t lo = i * cpus.size() / shards.size();
+        size_t hi = max(lo + 1, (i + 1) * cpus.size() / shards.size());
+        for (size_t k = lo; k < hi; ++k)
+            CPU_SET(cpus[k % cpus.size()], &shards[i].cpus);
+        shards[i].cpu_desc = to_string(cpus[lo % cpus.size()]);
+        if (hi - lo > 1)
+            shards[i].cpu_desc += "-" + to_string(cpus[(hi - 1) % cpus.size()]);
+    }
+}
+
+inline string shard_result_prefix(int i)
+{
+    return "shard" + to_string(i) + "_";
+}
+
+inline const char *shard_policy_name(ShardPolicy p)
+{
+    return p == SHARD_SJF ? "SJF" : "MLFQ";
+}
+
+// Child side: pin, take the socket as stdin, log to shard<i>.log and run the
+// scheduler until the front end closes its end.
+[[noreturn]] static void run_shard(const ShardConfig &cfg, int index, Shard &shard, int sock)
+{
+    if (sched_setaffinity(0, sizeof(shard.cpus), &shard.cpus) == -1)
+        perror("sched_setaffinity");
+    signal(SIGPIPE, SIG_IGN);
+    dup2(sock, STDIN_FILENO);
+
+    string log = "shard" + to_string(index) + ".log";
+    int fd = open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd != -1)
+    {
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+    }
+    cout << unitbuf;
+
+    {
+        OnlineScheduler scheduler;
+        scheduler.SetResultPrefix(shard_result_prefix(index));
+        scheduler.SetCompletionFd(sock);
+        if (cfg.policy == SHARD_SJF)
+            scheduler.ShortestJobFirst(cfg.sjf_k);
+        else
+        {
+            scheduler.EnableAdaptiveQuanta();
+            scheduler.MultiLevelFeedbackQueue(cfg.quanta[0], cfg.quanta[1], cfg.quanta[2], cfg.quanta[3]);
+        }
+    }
+    _exit(0);
+}
+
+inline bool start_shards(const ShardConfig &cfg, vector<Shard> &shards)
+{
+    shards.assign(static_cast<size_t>(max(1, min(cfg.shards, SHARD_MAX))), Shard());
+    assign_shard_cpus(cfg, shards);
+    cout.flush();
+    for (size_t i = 0; i < shards.size(); ++i)
+    {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1)
+        {
+            perror("socketpair");
+            return false;
+        }
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            return false;
+        }
+        if (pid == 0)
+        {
+            close(sv[0]);
+            for (size_t k = 0; k < i; ++k)
+                close(shards[k].sock);
+            run_shard(cfg, static_cast<int>(i), shards[i], sv[1]);
+        }
+        close(sv[1]);
+        fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+        shards[i].pid = pid;
+        shards[i].sock = sv[0];
+        cout << "Shard " << i << " (pid " << pid << ") on CPUs " << shards[i].cpu_desc << "\n";
+    }
+    return true;
+}
+
+// Least outstanding work, unless the shard that ran this command before is
+// within SHARD_AFFINITY_SLACK of it: its burst and behaviour history is warm.
+inline int route_command(vector<Shard> &shards, unordered_map<string, int> &affinity, const string &cmd)
+{
+    int least = -1;
+    uint64_t least_load = 0;
+    for (size_t i = 0; i < shards.size(); ++i)
+    {
+        if (!shards[i].writable)
+            continue;
+        uint64_t load = shards[i].routed - shards[i].completed;
+        if (least == -1 || load < least_load)
+        {
+            least = static_cast<int>(i);
+            least_load = load;
+        }
+    }
+    if (least == -1)
+        return -1;
+
+    auto it = affinity.find(cmd);
+    if (it != affinity.end() && shards[it->second].writable)
+    {
+        Shard &warm = shards[it->second];
+        if (warm.routed - warm.completed <= least_load + SHARD_AFFINITY_SLACK)
+        {
+            warm.affinity_hits++;
+            return it->second;
+        }
+    }
+    affinity[cmd] = least;
+    return least;
+}
+
+// Sends what the socket takes; the rest waits for POLLOUT. Returns false
+// once the shard stopped reading; whatever was still queued is dropped.
+inline bool flush_shard_outbox(Shard &shard)
+{
+    while (!shard.outbox.empty())
+    {
+        ssize_t n = send(shard.sock, shard.outbox.data(), shard.outbox.size(), MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            shard.outbox.erase(0, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        cerr << "Shard (pid " << shard.pid << ") stopped reading its input\n";
+        shard.writable = false;
+        shard.outbox.clear();
+        return false;
+    }
+    return true;
+}
+
+// Queues one formatted submission. Only counted as routed once the shard
+// took it (or may still take it from the outbox).
+inline bool send_to_shard(Shard &shard, const string &line)
+{
+    if (!shard.writable)
+        return false;
+    shard.outbox += line;
+    shard.outbox += '\n';
+    if (!flush_shard_outbox(shard))
+        return false;
+    shard.routed++;
+    return true;
+}
+
+// Where each submission went, indexed by its global id (submission order at
+// the front end, as a single scheduler would number it). shard is -1 for
+// submissions the front end rejected.
+struct ShardPlacement
+{
+    int shard;
+    uint32_t local_id; // the shard's own job handle
+};
+
+// The submission as the shard reads it: after: ids already in the shard's
+// numbering, weight and deadline as prefixes (see parse_submission).
+inline string format_shard_submission(const Submission &sub, const vector<uint32_t> &local_deps)
+{
+    string line;
+    for (size_t i = 0; i < local_deps.size(); ++i)
+        line += (i ? "," : "after:") + to_string(local_deps[i]);
+    if (!line.empty())
+        line += ' ';
+    if (sub.weight != 1.0 || sub.deadline_ms != 0)
+    {
+        char prefix[64];
+        snprintf(prefix, sizeof(prefix), "weight:%g deadline:%u ", sub.weight, sub.deadline_ms);
+        line += prefix;
+    }
+    line.append(sub.cmd, sub.len);
+    return line;
+}
+
+// Routes one submission. A job with after: dependencies runs on the shard
+// holding them, since shards cannot wait on each other; dependencies spread
+// over several shards are rejected. Anything else goes where route_command
+// says, moving on to the next shard if a send fails. Returns the shard, or -1.
+inline int submit_to_shards(vector<Shard> &shards, unordered_map<string, int> &affinity,
+                            vector<ShardPlacement> &placed, const string &line,
+                            double weight = 1.0, uint32_t deadline_ms = 0)
+{
+    if (line.size() > MAX_CMD_LEN)
+    {
+        cerr << "Command of " << line.size() << " bytes is longer than " << MAX_CMD_LEN << ", dropped\n";
+        return -1;
+    }
+    Submission sub = parse_submission(line.data(), line.size(), weight, deadline_ms);
+    if (sub.len == 0)
+    {
+        cerr << "Submission has prefixes but no command, ignored\n";
+        return -1;
+    }
+
+    long id = static_cast<long>(placed.size());
+    int target = -1;
+    vector<uint32_t> local_deps;
+    const char *why = nullptr;
+    for (long d : sub.deps)
+    {
+        if (d < 0)
+            d += id;
+        if (d < 0 || d >= id)
+        {
+            cerr << "Job " << id << ": ignoring dependency on unknown job " << d << "\n";
+            continue;
+        }
+        const ShardPlacement &p = placed[static_cast<size_t>(d)];
+        if (p.shard < 0)
+            why = "it depends on a rejected job";
+        else if (target >= 0 && p.shard != target)
+            why = "its dependencies are on different shards";
+        else
+        {
+            target = p.shard;
+            local_deps.push_back(p.local_id);
+        }
+    }
+
+    string cmd(sub.cmd, sub.len);
+    string out = format_shard_submission(sub, local_deps);
+    if (!why && out.size() > MAX_CMD_LEN)
+        why = "it is too long once its ids are rewritten";
+    int s = -1;
+    if (!why && target >= 0)
+    {
+        if (send_to_shard(shards[target], out))
+            s = target;
+        else
+            why = "the shard holding its dependencies is gone";
+    }
+    else if (!why)
+    {
+        // A failed send marks the shard unwritable, so the next pick differs.
+        while ((s = route_command(shards, affinity, cmd)) >= 0 && !send_to_shard(shards[s], out))
+            ;
+        if (s < 0)
+            why = "no shard accepted it";
+    }
+
+    if (why)
+    {
+        cerr << "Job " << id << " rejected, " << why << ": " << cmd << "\n";
+        placed.push_back({-1, 0});
+        return -1;
+    }
+    placed.push_back({s, static_cast<uint32_t>(shards[s].routed - 1)});
+    return s;
+}
+
+// Reads completion lines; returns false once the shard closed its end.
+inline bool read_completions(Shard &shard)
+{
+    char buf[4096];
+    ssize_t n = read(shard.sock, buf, sizeof(buf));
+    if (n < 0)
+        return errno == EINTR || errno == EAGAIN;
+    if (n == 0)
+        return false;
+    shard.partial.append(buf, static_cast<size_t>(n));
+    size_t start = 0, nl;
+    while ((nl = shard.partial.find('\n', start)) != string::npos)
+    {
+        unsigned handle, turnaround, response;
+        int error;
+        if (sscanf(shard.partial.c_str() + start, "%u %d %u %u", &handle, &error, &turnaround, &response) == 4)
+        {
+            shard.completed++;
+            shard.errors += error ? 1 : 0;
+            shard.turnaround_ms.push_back(turnaround);
+            shard.response_ms.push_back(response);
+        }
+        start = nl + 1;
+    }
+    shard.partial.erase(0, start);
+    return true;
+}
+
+// No more submissions: half-close every socket so the shards see EOF on
+// stdin, finish their queues and exit. Shards with a non-empty outbox are
+// closed by a later call, once it drained.
+inline void close_shard_inputs(vector<Shard> &shards)
+{
+    for (Shard &s : shards)
+        if (s.writable && s.outbox.empty())
+        {
+            shutdown(s.sock, SHUT_WR);
+            s.writable = false;
+        }
+}
+
+inline void wait_for_shards(vector<Shard> &shards)
+{
+    for (Shard &s : shards)
+    {
+        if (s.sock != -1)
+            close(s.sock);
+        s.sock = -1;
+        int status;
+        if (s.pid > 0)
+            waitpid(s.pid, &status, 0);
+    }
+}
+
+// Concatenates the per-shard result CSVs into one file with a Shard column.
+inline void merge_shard_results(const vector<Shard> &shards, ShardPolicy policy, const string &filename)
+{
+    ofstream out(filename);
+    if (!out)
+    {
+        cerr << "Could not open file " << filename << "\n";
+        return;
+    }
+    string suffix = string("result_online_") + shard_policy_name(policy) + ".csv";
+    out << "Shard," << ONLINE_CSV_HEADER;
+    for (size_t i = 0; i < shards.size(); ++i)
+    {
+        ifstream in(shard_result_prefix(static_cast<int>(i)) + suffix);
+        string line;
+        bool header = true;
+        while (getline(in, line))
+        {
+            if (header)
+            {
+                header = false;
+                continue;
+            }
+            if (!line.empty())
+                out << i << "," << line << "\n";
+        }
+    }
+}
+
+static double shard_percentile(vector<double> v, double p)
+{
+    if (v.empty())
+        return 0.0;
+    sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(p * static_cast<double>(v.size() - 1) + 0.5);
+    return v[min(idx, v.size() - 1)];
+}
+
+inline void print_shard_summary(const vector<Shard> &shards)
+{
+    Shard total;
+    cout << "Shard | CPUs | Routed | Completed | Errors | Affinity hits | Turnaround p50/p99 ms\n";
+    for (size_t i = 0; i < shards.size(); ++i)
+    {
+        const Shard &s = shards[i];
+        cout << i << " | " << s.cpu_desc << " | " << s.routed << " | " << s.completed << " | " << s.errors
+             << " | " << s.affinity_hits << " | " << shard_percentile(s.turnaround_ms, 0.5) << "/"
+             << shard_percentile(s.turnaround_ms, 0.99) << "\n";
+        total.routed += s.routed;
+        total.completed += s.completed;
+        total.errors += s.errors;
+        total.affinity_hits += s.affinity_hits;
+        total.turnaround_ms.insert(total.turnaround_ms.end(), s.turnaround_ms.begin(), s.turnaround_ms.end());
+        total.response_ms.insert(total.response_ms.end(), s.response_ms.begin(), s.response_ms.end());
+    }
+    cout << "all | - | " << total.routed << " | " << total.completed << " | " << total.errors
+         << " | " << total.affinity_hits << " | " << shard_percentile(total.turnaround_ms, 0.5) << "/"
+         << shard_percentile(total.turnaround_ms, 0.99)
+         << " (response p50/p99 " << shard_percentile(total.response_ms, 0.5) << "/"
+         << shard_percentile(total.response_ms, 0.99) << ")\n";
+}
@@ -0,0 +1,210 @@
+#pragma once
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+#include <algorithm>
+#include <iostream>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <vector>
+#include "Proc_stats.h"
+
+using namespace std;
+
+// Supervisor for warm restarts. It owns the terminal/stdin session and runs
+// the scheduler as a child. As a child subreaper it inherits the jobs of a
+// scheduler that exits or crashes. Their process groups stay in the session
+// under a live parent, so stopped jobs are not hit by the orphaned-group
+// SIGHUP/SIGCONT. Jobs that exit before a new scheduler adopts them are
+// reaped here and their wait status is appended to <checkpoint>.exits.
+// When the supervisor itself exits nothing could adopt them any more, so
+// the jobs still running are killed and recorded there as failed.
+
+#define SCHED_SUPERVISED_ENV "SCHED_SUPERVISED" // set in the scheduler the supervisor runs
+#define SCHED_RESTART_EXIT 75                   // scheduler exit code: checkpointed, start me again
+#define SUPERVISOR_RESTART_DELAY_MS 200         // pause before restarting a crashed scheduler, doubled per crash
+#define SUPERVISOR_MAX_RESTART_DELAY_MS 10000
+#define SUPERVISOR_MAX_CRASHES 5                // crashes in a row before giving up
+#define SUPERVISOR_STABLE_MS 30000              // a scheduler up this long resets the crash count
+
+inline string orphan_exits_path(const string &checkpoint_path)
+{
+    return checkpoint_path + ".exits";
+}
+
+inline void record_orphan_exit(const string &path, pid_t pid, int status)
+{
+    FILE *f = fopen(path.c_str(), "a");
+    if (!f)
+        return;
+    fprintf(f, "%d %d\n", static_cast<int>(pid), status);
+    fclose(f);
+}
+
+// Wait status the supervisor recorded for pid, if it reaped it.
+inline bool find_orphan_exit(const string &path, pid_t pid, int &status)
+{
+    FILE *f = fopen(path.c_str(), "r");
+    if (!f)
+        return false;
+    int p, st;
+    bool found = false;
+    while (fscanf(f, "%d %d", &p, &st) == 2)
+        if (p == static_cast<int>(pid))
+        {
+            status = st;
+            found = true; // keep the last one: pids get reused
+        }
+    fclose(f);
+    return found;
+}
+
+static volatile sig_atomic_t supervisor_signal = 0;
+
+static uint64_t supervisor_clock_ms()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return static_cast<uint64_t>(t.tv_sec) * 1000ULL + static_cast<uint64_t>(t.tv_nsec) / 1000000ULL;
+}
+
+static void supervisor_on_signal(int sig)
+{
+    supervisor_signal = sig;
+}
+
+// Kills the jobs the last scheduler left behind (children of the supervisor
+// by now, each leading its own process group) and records their exits so the
+// next start settles them as failed. Returns how many there were.
+static int stop_leftover_jobs(const string &exits)
+{
+    vector<int> left;
+    read_proc_children(getpid(), left);
+    for (int pid : left)
+    {
+        kill(-pid, SIGKILL);
+        kill(pid, SIGKILL);
+    }
+    for (int pid : left)
+    {
+        int status;
+        if (waitpid(pid, &status, 0) == pid)
+            record_orphan_exit(exits, pid, status);
+    }
+    return static_cast<int>(left.size());
+}
+
+static pid_t start_supervised_scheduler(const string &exe, char **argv)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        setenv(SCHED_SUPERVISED_ENV, "1", 1);
+        signal(SIGHUP, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        // exec by path so an upgraded binary is picked up on restart
+        execv(exe.c_str(), argv);
+        perror("execv");
+        _exit(127);
+    }
+    return pid;
+}
+
+// Runs the scheduler (this binary, argv unchanged) until it finishes.
+// SIGHUP asks for a warm restart: the scheduler checkpoints, exits with
+// SCHED_RESTART_EXIT and a fresh exec of the binary takes over. SIGTERM and
+// SIGINT stop it for good. A crashed scheduler is restarted after a growing
+// pause, up to SUPERVISOR_MAX_CRASHES times in a row. Jobs still running
+// when the supervisor stops are killed (see stop_leftover_jobs); jobs not yet
+// started stay queued in the checkpoint.
+inline int run_supervisor(char **argv, const string &checkpoint_path)
+{
+    if (prctl(PR_SET_CHILD_SUBREAPER, 1) == -1)
+        perror("prctl(PR_SET_CHILD_SUBREAPER)");
+
+    char exe[4096];
+    ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (n <= 0)
+        return 1;
+    exe[n] = '\0';
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = supervisor_on_signal;
+    sigaction(SIGHUP, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    sigaction(SIGINT, &sa, nullptr);
+
+    string exits = orphan_exits_path(checkpoint_path);
+    pid_t scheduler = start_supervised_scheduler(exe, argv);
+    uint64_t started_ms = supervisor_clock_ms();
+    int crashes = 0;
+    bool stopping = false;
+    int result = 0;
+    cout << "Supervisor " << getpid() << ": scheduler " << scheduler << " (SIGHUP for a warm restart)\n";
+
+    while (true)
+    {
+        int status;
+        pid_t r = waitpid(-1, &status, 0);
+        int sig = supervisor_signal;
+        supervisor_signal = 0;
+        if (sig != 0)
+        {
+            if (sig == SIGTERM || sig == SIGINT)
+                stopping = true;
+            if (scheduler > 0 && r != scheduler)
+                kill(scheduler, SIGTERM);
+        }
+        if (r == -1)
+        {
+            if (errno != EINTR)
+                break;
+            continue;
+        }
+        if (r != scheduler)
+        {
+            record_orphan_exit(exits, r, status);
+            continue;
+        }
+
+        bool restart = WIFEXITED(status) ? WEXITSTATUS(status) == SCHED_RESTART_EXIT : true;
+        if (WIFSIGNALED(status) && !stopping)
+        {
+            crashes = supervisor_clock_ms() - started_ms >= SUPERVISOR_STABLE_MS ? 1 : crashes + 1;
+            cerr << "Scheduler killed by signal " << WTERMSIG(status) << "\n";
+            if (crashes > SUPERVISOR_MAX_CRASHES)
+            {
+                cerr << "Scheduler crashed " << crashes << " times in a row, giving up; "
+                     << checkpoint_path << " is left for inspection\n";
+                result = 1;
+                break;
+            }
+            uint64_t delay = min<uint64_t>(SUPERVISOR_MAX_RESTART_DELAY_MS,
+                                           static_cast<uint64_t>(SUPERVISOR_RESTART_DELAY_MS) << (crashes - 1));
+            usleep(static_cast<useconds_t>(delay * 1000));
+            if (supervisor_signal == SIGTERM || supervisor_signal == SIGINT)
+                stopping = true;
+        }
+        if (!restart || stopping)
+        {
+            result = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+            break;
+        }
+        scheduler = start_supervised_scheduler(exe, argv);
+        started_ms = supervisor_clock_ms();
+        cout << "Supervisor: restarted scheduler as " << scheduler << "\n";
+    }
+    int left = stop_leftover_jobs(exits);
+    if (left > 0)
+        cout << "Supervisor: killed " << left << " job(s) still running; " << checkpoint_path
+             << " records them as failed\n";
+    return result == SCHED_RESTART_EXIT ? 0 : result;
+}
@@ -0,0 +1,225 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// Workload trace: one submission per line,
+//
+//     <offset_ms>,<weight>,<deadline_ms>,<command>
+//
+// offset_ms is the arrival time relative to the start of the trace, weight
+// scales the job's priority (1 = normal) and deadline_ms is a turnaround
+// target (0 = none). The command is the rest of the line and may contain
+// commas. Blank lines and lines starting with '#' are skipped.
+
+struct TraceEntry
+{
+    uint64_t offset_ms = 0;
+    double weight = 1.0;
+    uint32_t deadline_ms = 0;
+    const char *cmd = nullptr; // points into the mapping, not NUL-terminated
+    size_t cmd_len = 0;
+};
+
+// Streams a trace file from an mmap'd view; entries are parsed only when
+// they are about to be due, so traces of any size replay in constant memory.
+struct TraceReplay
+{
+    const char *map = nullptr;
+    size_t map_len = 0;
+    const char *cursor = nullptr;
+    double speedup = 1.0;
+    int loops = 1;              // 0 = loop forever
+    int loop_no = 0;
+    uint64_t start_ms = 0;      // scheduler time the replay started at, 0 until first poll
+    uint64_t loop_base_ms = 0;  // trace time at which the current loop started
+    uint64_t max_offset_ms = 0;
+    TraceEntry pending;
+    bool has_pending = false;
+    bool done = true;
+};
+
+static bool parse_trace_line(const char *p, const char *eol, TraceEntry &e)
+{
+    while (p < eol && (*p == ' ' || *p == '\t'))
+        ++p;
+    if (p == eol || *p == '#' || *p == '\r')
+        return false;
+
+    // Three numeric fields, then the command verbatim.
+    const char *start[3], *stop[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        start[i] = p;
+        while (p < eol && *p != ',')
+            ++p;
+        if (p == eol)
+            return false;
+        stop[i] = p++;
+    }
+    char num[32];
+    auto field = [&](int i) {
+        size_t n = min(static_cast<size_t>(stop[i] - start[i]), sizeof(num) - 1);
+        memcpy(num, start[i], n);
+        num[n] = '\0';
+        return num;
+    };
+    e.offset_ms = strtoull(field(0), nullptr, 10);
+    e.weight = atof(field(1));
+    if (e.weight <= 0.0)
+        e.weight = 1.0;
+    e.deadline_ms = static_cast<uint32_t>(strtoul(field(2), nullptr, 10));
+
+    size_t len = static_cast<size_t>(eol - p);
+    while (len > 0 && (p[len - 1] == '\r' || p[len - 1] == ' '))
+        len--;
+    if (len == 0)
+        return false;
+    e.cmd = p;
+    e.cmd_len = len;
+    return true;
+}
+
+// Parses the next entry into r.pending, wrapping around for further loops.
+static bool advance_trace(TraceReplay &r)
+{
+    const char *end = r.map + r.map_len;
+    for (int wraps = 0; wraps < 2; ++wraps)
+    {
+        while (r.cursor < end)
+        {
+            const char *eol = static_cast<const char *>(memchr(r.cursor, '\n', static_cast<size_t>(end - r.cursor)));
+            if (!eol)
+                eol = end;
+            const char *line = r.cursor;
+            r.cursor = (eol < end) ? eol + 1 : end;
+            if (parse_trace_line(line, eol, r.pending))
+            {
+                r.max_offset_ms = max(r.max_offset_ms, r.pending.offset_ms);
+                r.has_pending = true;
+                return true;
+            }
+        }
+        r.loop_no++;
+        if (r.loops != 0 && r.loop_no >= r.loops)
+            break;
+        r.cursor = r.map;
+        r.loop_base_ms += max<uint64_t>(r.max_offset_ms, 1);
+    }
+    r.has_pending = false;
+    r.done = true;
+    return false;
+}
+
+inline bool open_trace(TraceReplay &r, const string &path, double speedup, int loops)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        cerr << "Could not open trace " << path << "\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+    void *m = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED)
+        return false;
+    madvise(m, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+    r = TraceReplay();
+    r.map = static_cast<const char *>(m);
+    r.map_len = static_cast<size_t>(st.st_size);
+    r.cursor = r.map;
+    r.speedup = speedup > 0.0 ? speedup : 1.0;
+    r.loops = loops;
+    r.done = false;
+    advance_trace(r);
+    return true;
+}
+
+inline void close_trace(TraceReplay &r)
+{
+    if (r.map)
+        munmap(const_cast<char *>(r.map), r.map_len);
+    r.map = nullptr;
+    r.done = true;
+    r.has_pending = false;
+}
+
+// Scheduler time (ms) at which the pending entry is due.
+inline uint64_t trace_due_ms(const TraceReplay &r)
+{
+    return r.start_ms + static_cast<uint64_t>(static_cast<double>(r.loop_base_ms + r.pending.offset_ms) / r.speedup);
+}
+
+// Hands every entry due by `now` to submit(entry, due_ms). Returns how many.
+template <typename Submit>
+int poll_trace(TraceReplay &r, uint64_t now, Submit submit)
+{
+    if (r.done)
+        return 0;
+    if (r.start_ms == 0)
+        r.start_ms = now ? now : 1;
+    int added = 0;
+    while (r.has_pending && trace_due_ms(r) <= now)
+    {
+        submit(r.pending, trace_due_ms(r));
+        added++;
+        advance_trace(r);
+    }
+    if (r.done)
+        close_trace(r);
+    return added;
+}
+
+// Appends live submissions in the same format so they can be replayed.
+struct TraceRecorder
+{
+    FILE *out = nullptr;
+    uint64_t start_ms = 0;
+};
+
+inline bool open_trace_recorder(TraceRecorder &rec, const string &path, uint64_t now)
+{
+    rec.out = fopen(path.c_str(), "w");
+    if (!rec.out)
+    {
+        cerr << "Could not open trace " << path << "\n";
+        return false;
+    }
+    rec.start_ms = now;
+    fprintf(rec.out, "# offset_ms,weight,deadline_ms,command\n");
+    return true;
+}
+
+inline void record_trace_entry(TraceRecorder &rec, uint64_t now, double weight, uint32_t deadline_ms,
+                               const char *cmd, size_t len)
+{
+    if (!rec.out)
+        return;
+    fprintf(rec.out, "%llu,%g,%u,%.*s\n", static_cast<unsigned long long>(now - rec.start_ms),
+            weight, deadline_ms, static_cast<int>(len), cmd);
+    fflush(rec.out);
+}
+
+inline void close_trace_recorder(TraceRecorder &rec)
+{
+    if (rec.out)
+        fclose(rec.out);
+    rec.out = nullptr;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+
+// Number of operator new calls so far. Defined by bench/alloc_counter.cpp
+// when it is linked in (SCHED_COUNT_ALLOCS); weak so benchmarks also build
+// and run without it.
+extern "C" uint64_t sched_alloc_count() __attribute__((weak));
+
+inline bool alloc_counting_enabled()
+{
+    return sched_alloc_count != nullptr;
+}
+
+inline uint64_t alloc_count()
+{
+    return sched_alloc_count ? sched_alloc_count() : 0;
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+// Synthetic workloads for the scheduler benchmark. A workload is a list of
+// burn invocations with arrival offsets, written in the Trace_replay.h format
+// so the online schedulers can replay it unchanged.
+
+enum WorkloadMix
+{
+    MIX_HEAVY_TAILED = 0, // Pareto CPU demand: many tiny jobs, a few huge ones
+    MIX_BIMODAL,          // short interactive jobs plus a band of long batch jobs
+    MIX_INTERACTIVE       // mostly I/O-bound jobs with a minority of CPU hogs
+};
+
+enum ArrivalProcess
+{
+    ARRIVE_BATCH = 0, // everything at t=0
+    ARRIVE_POISSON,   // exponential inter-arrival gaps at rate_per_s
+    ARRIVE_BURSTY     // bursts of burst_size jobs, bursts Poisson at rate_per_s / burst_size
+};
+
+struct WorkloadSpec
+{
+    WorkloadMix mix = MIX_HEAVY_TAILED;
+    ArrivalProcess arrival = ARRIVE_POISSON;
+    int jobs = 30;
+    double rate_per_s = 10.0;
+    int burst_size = 8;
+    double scale = 1.0;     // multiplies every CPU and I/O demand
+    uint32_t seed = 1;
+    string burn_path = "./burn";
+};
+
+struct WorkloadJob
+{
+    uint64_t offset_ms = 0;
+    uint32_t cpu_ms = 0;
+    uint32_t io_ms = 0;
+    int phases = 1;
+    string command;
+};
+
+#define HEAVY_TAIL_ALPHA 1.5 // Pareto shape; < 2 gives infinite variance
+#define HEAVY_TAIL_MIN_MS 5.0
+#define HEAVY_TAIL_MAX_MS 3000.0
+
+inline const char *mix_name(WorkloadMix m)
+{
+    static const char *names[] = {"heavy_tailed", "bimodal", "interactive"};
+    return names[m];
+}
+
+inline const char *arrival_name(ArrivalProcess a)
+{
+    static const char *names[] = {"batch", "poisson", "bursty"};
+    return names[a];
+}
+
+inline bool parse_mix(const string &s, WorkloadMix &out)
+{
+    for (int i = 0; i <= MIX_INTERACTIVE; ++i)
+        if (s == mix_name(static_cast<WorkloadMix>(i)))
+        {
+            out = static_cast<WorkloadMix>(i);
+            return true;
+        }
+    return false;
+}
+
+inline bool parse_arrival(const string &s, ArrivalProcess &out)
+{
+    for (int i = 0; i <= ARRIVE_BURSTY; ++i)
+        if (s == arrival_name(static_cast<ArrivalProcess>(i)))
+        {
+            out = static_cast<ArrivalProcess>(i);
+            return true;
+        }
+    return false;
+}
+
+static void draw_demand(const WorkloadSpec &spec, mt19937 &rng, WorkloadJob &job)
+{
+    uniform_real_distribution<double> u(0.0, 1.0);
+    switch (spec.mix)
+    {
+    case MIX_HEAVY_TAILED:
+    {
+        double x = HEAVY_TAIL_MIN_MS / pow(1.0 - u(rng), 1.0 / HEAVY_TAIL_ALPHA);
+        job.cpu_ms = static_cast<uint32_t>(min(x, HEAVY_TAIL_MAX_MS));
+        break;
+    }
+    case MIX_BIMODAL:
+        if (u(rng) < 0.9)
+            job.cpu_ms = static_cast<uint32_t>(5 + u(rng) * 15);
+        else
+            job.cpu_ms = static_cast<uint32_t>(800 + u(rng) * 400);
+        break;
+    case MIX_INTERACTIVE:
+        if (u(rng) < 0.8)
+        {
+            job.cpu_ms = static_cast<uint32_t>(2 + u(rng) * 8);
+            job.io_ms = static_cast<uint32_t>(50 + u(rng) * 150);
+            job.phases = 5;
+        }
+        else
+            job.cpu_ms = static_cast<uint32_t>(300 + u(rng) * 700);
+        break;
+    }
+    job.cpu_ms = static_cast<uint32_t>(job.cpu_ms * spec.scale);
+    job.io_ms = static_cast<uint32_t>(job.io_ms * spec.scale);
+}
+
+inline vector<WorkloadJob> generate_workload(const WorkloadSpec &spec)
+{
+    mt19937 rng(spec.seed);
+    double rate = spec.rate_per_s > 0.0 ? spec.rate_per_s : 1.0;
+    exponential_distribution<double> gap_s(rate);
+    exponential_distribution<double> burst_gap_s(rate / max(1, spec.burst_size));
+
+    vector<WorkloadJob> jobs(static_cast<size_t>(max(0, spec.jobs)));
+    double t_ms = 0.0;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        WorkloadJob &job = jobs[i];
+        if (spec.arrival == ARRIVE_POISSON && i > 0)
+            t_ms += 1000.0 * gap_s(rng);
+        else if (spec.arrival == ARRIVE_BURSTY && i > 0 && i % static_cast<size_t>(max(1, spec.burst_size)) == 0)
+            t_ms += 1000.0 * burst_gap_s(rng);
+        job.offset_ms = static_cast<uint64_t>(t_ms);
+        draw_demand(spec, rng, job);
+        job.command = spec.burn_path + " " + to_string(job.cpu_ms);
+        if (job.io_ms)
+            job.command += " " + to_string(job.io_ms) + " " + to_string(job.phases);
+    }
+    return jobs;
+}
+
+inline bool write_workload_trace(const vector<WorkloadJob> &jobs, const WorkloadSpec &spec, const string &path)
+{
+    FILE *out = fopen(path.c_str(), "w");
+    if (!out)
+    {
+        cerr << "Could not open trace " << path << "\n";
+        return false;
+    }
+    fprintf(out, "# mix=%s arrival=%s jobs=%d rate=%g seed=%u\n",
+            mix_name(spec.mix), arrival_name(spec.arrival), spec.jobs, spec.rate_per_s, spec.seed);
+    fprintf(out, "# offset_ms,weight,deadline_ms,command\n");
+    for (const WorkloadJob &j : jobs)
+        fprintf(out, "%llu,1,0,%s\n", static_cast<unsigned long long>(j.offset_ms), j.command.c_str());
+    fclose(out);
+    return true;
+}
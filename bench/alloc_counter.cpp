@@ -0,0 +1,49 @@
+// Replaces the global operator new/delete with malloc/free wrappers that
+// count allocations, so benchmarks can report allocations per operation.
+// Link it into a target to enable counting; see Alloc_counter.h.
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> alloc_calls{0};
+
+static void *counted_malloc(std::size_t n)
+{
+    alloc_calls.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(n ? n : 1);
+}
+
+extern "C" uint64_t sched_alloc_count()
+{
+    return alloc_calls.load(std::memory_order_relaxed);
+}
+
+void *operator new(std::size_t n)
+{
+    if (void *p = counted_malloc(n))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t n)
+{
+    return operator new(n);
+}
+
+void *operator new(std::size_t n, const std::nothrow_t &) noexcept
+{
+    return counted_malloc(n);
+}
+
+void *operator new[](std::size_t n, const std::nothrow_t &) noexcept
+{
+    return counted_malloc(n);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { std::free(p); }
@@ -0,0 +1,46 @@
+// Benchmark job: burns a given amount of CPU time, optionally split into
+// phases separated by sleeps that stand in for blocking I/O.
+//
+//     burn <cpu_ms> [io_ms] [phases]
+//
+// cpu_ms and io_ms are totals spread evenly over the phases; "burn 0" exits
+// immediately. CPU time is measured with the process CPU clock, so a job
+// that gets preempted still does the same amount of work.
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+
+static uint64_t cpu_time_us()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return static_cast<uint64_t>(t.tv_sec) * 1000000 + static_cast<uint64_t>(t.tv_nsec) / 1000;
+}
+
+static void burn_cpu_us(uint64_t us)
+{
+    uint64_t end = cpu_time_us() + us;
+    volatile uint64_t sink = 0;
+    while (cpu_time_us() < end)
+        for (int i = 0; i < 10000; ++i)
+            sink = sink + static_cast<uint64_t>(i);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t cpu_ms = argc > 1 ? strtoull(argv[1], nullptr, 10) : 0;
+    uint64_t io_ms = argc > 2 ? strtoull(argv[2], nullptr, 10) : 0;
+    int phases = argc > 3 ? atoi(argv[3]) : 1;
+    if (phases < 1)
+        phases = 1;
+
+    for (int i = 0; i < phases; ++i)
+    {
+        if (cpu_ms)
+            burn_cpu_us(cpu_ms * 1000 / static_cast<uint64_t>(phases));
+        if (io_ms)
+            usleep(static_cast<useconds_t>(io_ms * 1000 / static_cast<uint64_t>(phases)));
+    }
+    return 0;
+}
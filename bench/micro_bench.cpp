@@ -0,0 +1,299 @@
+// Microbenchmarks for the scheduler's per-tick hot paths. Each one is run
+// against tables of 10 up to 1M entries and reported as CSV:
+//
+//     benchmark,size,iterations,ns_per_op,allocs_per_op
+//
+// allocs_per_op is "-" unless bench/alloc_counter.cpp is linked in
+// (SCHED_COUNT_ALLOCS).
+#include "../Offline_scheduler.h"
+#include "../Online_scheduler.h"
+#include "Alloc_counter.h"
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+
+#define MICRO_MIN_TIME_MS 20        // each measurement runs at least this long
+#define MICRO_MAX_HISTORY 100000    // CmdHistory is ~440 bytes; larger tables are skipped
+#define MICRO_RANDOM_KEYS 4096      // precomputed random probes per table
+#define MICRO_POLL_LINES 32         // submissions per poll_and_enqueue_new_commands call
+
+struct MicroResult
+{
+    uint64_t iterations = 0;
+    double ns_per_op = 0.0;
+    double allocs_per_op = 0.0;
+};
+
+static uint64_t now_ns()
+{
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+                                     chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+// Runs op in growing batches until the batch takes MICRO_MIN_TIME_MS.
+template <typename Op>
+MicroResult measure(Op op)
+{
+    MicroResult r;
+    for (uint64_t batch = 1;; batch *= 2)
+    {
+        uint64_t allocs = alloc_count();
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < batch; ++i)
+            op(i);
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed >= MICRO_MIN_TIME_MS * 1000000ULL || batch >= (1ULL << 30))
+        {
+            r.iterations = batch;
+            r.ns_per_op = static_cast<double>(elapsed) / static_cast<double>(batch);
+            r.allocs_per_op = static_cast<double>(alloc_count() - allocs) / static_cast<double>(batch);
+            return r;
+        }
+    }
+}
+
+// For operations that consume their input: reset() runs untimed before
+// every op, so only op itself is counted.
+template <typename Reset, typename Op>
+MicroResult measure_with_reset(Reset reset, Op op)
+{
+    MicroResult r;
+    uint64_t spent = 0, allocs = 0;
+    while (spent < MICRO_MIN_TIME_MS * 1000000ULL)
+    {
+        reset();
+        uint64_t a = alloc_count();
+        uint64_t start = now_ns();
+        op();
+        spent += now_ns() - start;
+        allocs += alloc_count() - a;
+        r.iterations++;
+    }
+    r.ns_per_op = static_cast<double>(spent) / static_cast<double>(r.iterations);
+    r.allocs_per_op = static_cast<double>(allocs) / static_cast<double>(r.iterations);
+    return r;
+}
+
+static void report(const char *name, size_t size, const MicroResult &r)
+{
+    printf("%s,%zu,%llu,%.1f,", name, size, static_cast<unsigned long long>(r.iterations), r.ns_per_op);
+    if (alloc_counting_enabled())
+        printf("%.3f\n", r.allocs_per_op);
+    else
+        printf("-\n");
+    fflush(stdout);
+}
+
+static string bench_command(size_t i)
+{
+    return "./burn " + to_string(i) + " --tag job-" + to_string(i * 2654435761u % 100000);
+}
+
+static vector<uint32_t> random_keys(size_t n, uint32_t seed)
+{
+    mt19937 rng(seed);
+    uniform_int_distribution<uint32_t> pick(0, static_cast<uint32_t>(n - 1));
+    vector<uint32_t> keys(MICRO_RANDOM_KEYS);
+    for (uint32_t &k : keys)
+        k = pick(rng);
+    return keys;
+}
+
+static void clear_level_queues()
+{
+    q0arr = queue<JobHandle>();
+    q1arr = queue<JobHandle>();
+    q2arr = queue<JobHandle>();
+}
+
+// Drops every job past the first n so repeated submissions keep the table size fixed.
+static void truncate_jobs(JobTable &jobs, size_t n)
+{
+    jobs.pid.resize(n);
+    jobs.state.resize(n);
+    jobs.level.resize(n);
+    jobs.history_index.resize(n);
+    jobs.total_cpu_ms.resize(n);
+    jobs.weight.resize(n);
+    jobs.runtime_slot.resize(n);
+    jobs.metrics.resize(n);
+}
+
+static void bench_get_avg_burst_ms(size_t n)
+{
+    if (n > MICRO_MAX_HISTORY)
+        return;
+    vector<CmdHistory> histories(n);
+    for (size_t i = 0; i < n; ++i)
+        for (int b = 0; b < 5; ++b)
+            record_burst_to_history(histories, static_cast<int>(i), static_cast<double>(10 * b + i % 7));
+    vector<uint32_t> keys = random_keys(n, 1);
+    double sink = 0.0;
+    MicroResult r = measure([&](uint64_t i) {
+        sink += get_avg_burst_ms(histories, static_cast<int>(keys[i % MICRO_RANDOM_KEYS]), 3);
+    });
+    report("get_avg_burst_ms", n, r);
+    if (sink < 0.0)
+        printf("# %f\n", sink);
+}
+
+static void bench_find_history_index(size_t n)
+{
+    CommandArena arena;
+    for (size_t i = 0; i < n; ++i)
+        arena.intern(bench_command(i));
+    vector<uint32_t> idx = random_keys(n, 2);
+    vector<string> keys;
+    for (size_t i = 0; i < 1024; ++i)
+        keys.push_back(bench_command(idx[i]));
+    long sink = 0;
+    MicroResult r = measure([&](uint64_t i) {
+        sink += find_history_index(arena, keys[i % keys.size()]);
+    });
+    report("find_history_index", n, r);
+    if (sink < 0)
+        printf("# %ld\n", sink);
+}
+
+static void bench_is_queued(size_t n)
+{
+    JobTable jobs;
+    for (size_t i = 0; i < n; ++i)
+    {
+        JobHandle h = jobs.add(0, 0);
+        if (i % 3)
+            jobs.level[h] = static_cast<int8_t>(i % 3);
+    }
+    vector<uint32_t> keys = random_keys(n, 3);
+    long sink = 0;
+    MicroResult r = measure([&](uint64_t i) {
+        sink += is_queued(jobs, keys[i % MICRO_RANDOM_KEYS]);
+    });
+    report("is_queued", n, r);
+    if (sink < 0)
+        printf("# %ld\n", sink);
+}
+
+static void bench_promote_all_to_q0(size_t n)
+{
+    JobTable jobs;
+    for (size_t i = 0; i < n; ++i)
+        jobs.add(0, 0);
+    MicroResult r = measure_with_reset(
+        [&]() {
+            clear_level_queues();
+            for (JobHandle h = 0; h < jobs.size(); ++h)
+                push_to_level(jobs, h, 1 + static_cast<int>(h % 2));
+        },
+        [&]() { promote_all_to_q0(jobs, static_cast<int>(n)); });
+    clear_level_queues();
+    report("promote_all_to_q0", n, r);
+}
+
+// Size is the number of whitespace-separated tokens in the command.
+static void bench_parse_command(size_t n)
+{
+    string command;
+    for (size_t i = 0; i < n; ++i)
+        command += (i ? " arg" : "./burn") + to_string(i % 100);
+    MicroResult r = measure([&](uint64_t) {
+        vector<char *> argv;
+        vector<string> tokens;
+        parse_command(command, argv, tokens);
+    });
+    report("parse_command", n, r);
+}
+
+// Submissions arrive through a pipe dup2'd onto stdin, exactly as in a live
+// run; each op polls one batch of MICRO_POLL_LINES lines for known commands
+// against a table of n jobs.
+static void bench_poll_and_enqueue(size_t n)
+{
+    JobTable jobs;
+    CommandArena arena;
+    vector<CmdHistory> histories;
+    size_t distinct = min<size_t>(n, MICRO_MAX_HISTORY);
+    for (size_t i = 0; i < n; ++i)
+    {
+        string cmd = bench_command(i % distinct);
+        enqueue_command(jobs, arena, histories, cmd.data(), cmd.size(), 0);
+    }
+    string batch;
+    for (size_t i = 0; i < MICRO_POLL_LINES; ++i)
+        batch += bench_command((i * 7919) % distinct) + "\n";
+
+    int fds[2];
+    if (pipe(fds) == -1)
+        return;
+    int saved_stdin = dup(STDIN_FILENO);
+    dup2(fds[0], STDIN_FILENO);
+    close(fds[0]);
+    set_stdin_nonblocking(true);
+
+    MicroResult r = measure_with_reset(
+        [&]() {
+            truncate_jobs(jobs, n);
+            if (write(fds[1], batch.data(), batch.size()) != static_cast<ssize_t>(batch.size()))
+                perror("write");
+        },
+        [&]() { poll_and_enqueue_new_commands(jobs, arena, histories, 0); });
+    report("poll_and_enqueue_new_commands", n, r);
+
+    set_stdin_nonblocking(false);
+    close(fds[1]);
+    dup2(saved_stdin, STDIN_FILENO);
+    close(saved_stdin);
+}
+
+int main(int argc, char **argv)
+{
+    size_t max_size = 1000000;
+    string only;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string opt = argv[i];
+        if (opt == "--max")
+            max_size = strtoull(argv[i + 1], nullptr, 10);
+        else if (opt == "--only")
+            only = argv[i + 1];
+        else
+        {
+            fprintf(stderr, "Usage: %s [--max entries] [--only benchmark]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // The scheduler's own logging would swamp the results.
+    cout.rdbuf(nullptr);
+    set_program_start_time();
+
+    struct
+    {
+        const char *name;
+        void (*run)(size_t);
+    } benches[] = {
+        {"get_avg_burst_ms", bench_get_avg_burst_ms},
+        {"find_history_index", bench_find_history_index},
+        {"is_queued", bench_is_queued},
+        {"promote_all_to_q0", bench_promote_all_to_q0},
+        {"parse_command", bench_parse_command},
+        {"poll_and_enqueue_new_commands", bench_poll_and_enqueue},
+    };
+
+    printf("benchmark,size,iterations,ns_per_op,allocs_per_op\n");
+    for (const auto &b : benches)
+    {
+        if (!only.empty() && only != b.name)
+            continue;
+        for (size_t n = 10; n <= max_size; n *= 10)
+            b.run(n);
+    }
+    return 0;
+}
@@ -0,0 +1,308 @@
+// End-to-end scheduler benchmark: generates a synthetic workload of burn
+// jobs, runs it through the offline FCFS/RR/MLFQ and online SJF/MLFQ
+// schedulers and writes per-policy latency, throughput and overhead figures
+// as JSON for regression tracking.
+#include "../Offline_scheduler.h"
+#include "../Online_scheduler.h"
+#include "Workload.h"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace std;
+
+struct BenchOptions
+{
+    WorkloadSpec workload;
+    string trace_path = "bench_workload.trace";
+    string out_path = "bench_results.json";
+    vector<string> policies = {"fcfs", "rr", "mlfq", "online_sjf", "online_mlfq"};
+    int quanta[4] = {500, 1000, 2000, 4000}; // q0, q1, q2, boost; RR uses q0
+    int sjf_k = 3;
+    bool generate_only = false;
+    bool quiet = false;
+};
+
+struct RunStats
+{
+    string policy;
+    vector<double> response_ms, turnaround_ms;
+    int completed = 0, errors = 0;
+    uint64_t wall_ms = 0;
+    double sched_cpu_ms = 0.0;
+    uint64_t ctx_switches = 0;
+};
+
+struct UsageSnapshot
+{
+    uint64_t wall_us;
+    double self_cpu_ms;
+    uint64_t switches; // scheduler + reaped children, voluntary and involuntary
+};
+
+static double timeval_ms(const struct timeval &tv)
+{
+    return static_cast<double>(tv.tv_sec) * 1000.0 + static_cast<double>(tv.tv_usec) / 1000.0;
+}
+
+static UsageSnapshot take_usage()
+{
+    UsageSnapshot s;
+    s.wall_us = now_us();
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    s.self_cpu_ms = timeval_ms(self.ru_utime) + timeval_ms(self.ru_stime);
+    s.switches = static_cast<uint64_t>(self.ru_nvcsw + self.ru_nivcsw + children.ru_nvcsw + children.ru_nivcsw);
+    return s;
+}
+
+static void finish_usage(RunStats &r, const UsageSnapshot &before)
+{
+    UsageSnapshot after = take_usage();
+    r.wall_ms = (after.wall_us - before.wall_us) / 1000;
+    r.sched_cpu_ms = after.self_cpu_ms - before.self_cpu_ms;
+    r.ctx_switches = after.switches - before.switches;
+}
+
+// Nearest-rank percentile of an unsorted sample.
+static double percentile(vector<double> v, double p)
+{
+    if (v.empty())
+        return 0.0;
+    sort(v.begin(), v.end());
+    size_t rank = static_cast<size_t>(ceil(p * static_cast<double>(v.size())));
+    return v[min(v.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+// The offline schedulers have no notion of arrivals: every job is present at
+// t=0, so completion time is also turnaround.
+static RunStats run_offline(const string &policy, const vector<WorkloadJob> &workload, const BenchOptions &opt)
+{
+    vector<Process> processes;
+    for (const WorkloadJob &j : workload)
+        processes.push_back(Process{j.command});
+
+    RunStats r;
+    r.policy = policy;
+    UsageSnapshot before = take_usage();
+    if (policy == "fcfs")
+        FCFS(processes);
+    else if (policy == "rr")
+        RoundRobin(processes, opt.quanta[0]);
+    else
+        MultiLevelFeedbackQueue(processes, opt.quanta[0], opt.quanta[1], opt.quanta[2], opt.quanta[3]);
+    finish_usage(r, before);
+
+    for (const Process &p : processes)
+    {
+        r.completed += p.finished ? 1 : 0;
+        r.errors += p.error ? 1 : 0;
+        r.response_ms.push_back(static_cast<double>(p.response_time));
+        r.turnaround_ms.push_back(static_cast<double>(p.completion_time));
+    }
+    return r;
+}
+
+// Each online run gets a fresh scheduler fed only from the trace, so it sees
+// the generated arrival process and no stdin.
+static RunStats run_online(const string &policy, const BenchOptions &opt)
+{
+    RunStats r;
+    r.policy = policy;
+    OnlineScheduler scheduler;
+    scheduler.SetOutputCapture(false);
+    if (!scheduler.ReplayTrace(opt.trace_path, 1.0, 1, false))
+        return r;
+
+    UsageSnapshot before = take_usage();
+    if (policy == "online_sjf")
+        scheduler.ShortestJobFirst(opt.sjf_k);
+    else
+    {
+        scheduler.EnableAdaptiveQuanta();
+        scheduler.MultiLevelFeedbackQueue(opt.quanta[0], opt.quanta[1], opt.quanta[2], opt.quanta[3]);
+    }
+    finish_usage(r, before);
+
+    const JobTable &jobs = scheduler.Jobs();
+    for (JobHandle h = 0; h < jobs.size(); ++h)
+    {
+        const JobMetrics &m = jobs.metrics[h];
+        bool err = jobs.error(h);
+        r.completed += (jobs.finished(h) && !err) ? 1 : 0;
+        r.errors += err ? 1 : 0;
+        r.response_ms.push_back(static_cast<double>(m.response_time));
+        r.turnaround_ms.push_back(static_cast<double>(m.turnaround_time));
+    }
+    return r;
+}
+
+static void write_latency_json(FILE *out, const char *name, const vector<double> &v)
+{
+    fprintf(out, "\"%s\": {\"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f}",
+            name, percentile(v, 0.50), percentile(v, 0.99), percentile(v, 0.999), percentile(v, 1.0));
+}
+
+static void write_results_json(FILE *out, const BenchOptions &opt, const vector<RunStats> &runs)
+{
+    const WorkloadSpec &w = opt.workload;
+    fprintf(out, "{\n  \"workload\": {\"mix\": \"%s\", \"arrival\": \"%s\", \"jobs\": %d, \"rate_per_s\": %g, "
+                 "\"burst_size\": %d, \"scale\": %g, \"seed\": %u},\n",
+            mix_name(w.mix), arrival_name(w.arrival), w.jobs, w.rate_per_s, w.burst_size, w.scale, w.seed);
+    fprintf(out, "  \"quanta_ms\": [%d, %d, %d], \"boost_ms\": %d,\n", opt.quanta[0], opt.quanta[1], opt.quanta[2], opt.quanta[3]);
+    fprintf(out, "  \"results\": [\n");
+    for (size_t i = 0; i < runs.size(); ++i)
+    {
+        const RunStats &r = runs[i];
+        double wall_s = max(1e-3, static_cast<double>(r.wall_ms) / 1000.0);
+        fprintf(out, "    {\"policy\": \"%s\", \"jobs\": %zu, \"completed\": %d, \"errors\": %d, \"wall_ms\": %llu, ",
+                r.policy.c_str(), r.response_ms.size(), r.completed, r.errors, static_cast<unsigned long long>(r.wall_ms));
+        fprintf(out, "\"throughput_jobs_per_s\": %.3f, ", static_cast<double>(r.completed) / wall_s);
+        write_latency_json(out, "response_ms", r.response_ms);
+        fprintf(out, ", ");
+        write_latency_json(out, "turnaround_ms", r.turnaround_ms);
+        fprintf(out, ", \"scheduler_cpu_ms\": %.1f, \"scheduler_cpu_pct\": %.2f, \"ctx_switches_per_s\": %.1f}%s\n",
+                r.sched_cpu_ms, 100.0 * r.sched_cpu_ms / (wall_s * 1000.0),
+                static_cast<double>(r.ctx_switches) / wall_s, i + 1 < runs.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static vector<string> split_list(const string &s)
+{
+    vector<string> out;
+    stringstream ss(s);
+    string item;
+    while (getline(ss, item, ','))
+        if (!item.empty())
+            out.push_back(item);
+    return out;
+}
+
+static void usage(const char *prog)
+{
+    cerr << "Usage: " << prog << " [--mix heavy_tailed|bimodal|interactive] [--arrival batch|poisson|bursty]\n"
+         << "       [--jobs n] [--rate jobs_per_s] [--burst n] [--scale x] [--seed n] [--burn path]\n"
+         << "       [--policies fcfs,rr,mlfq,online_sjf,online_mlfq] [--quanta q0,q1,q2,boost]\n"
+         << "       [--trace path] [--out path] [--generate-only] [--quiet]\n";
+}
+
+static bool parse_options(int argc, char **argv, BenchOptions &opt)
+{
+    // burn is expected next to this binary unless told otherwise.
+    string self = argv[0];
+    size_t slash = self.rfind('/');
+    opt.workload.burn_path = (slash == string::npos ? string(".") : self.substr(0, slash)) + "/burn";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string a = argv[i];
+        if (a == "--generate-only")
+        {
+            opt.generate_only = true;
+            continue;
+        }
+        if (a == "--quiet")
+        {
+            opt.quiet = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            return false;
+        string v = argv[++i];
+        if (a == "--mix")
+        {
+            if (!parse_mix(v, opt.workload.mix))
+                return false;
+        }
+        else if (a == "--arrival")
+        {
+            if (!parse_arrival(v, opt.workload.arrival))
+                return false;
+        }
+        else if (a == "--jobs")
+            opt.workload.jobs = atoi(v.c_str());
+        else if (a == "--rate")
+            opt.workload.rate_per_s = atof(v.c_str());
+        else if (a == "--burst")
+            opt.workload.burst_size = atoi(v.c_str());
+        else if (a == "--scale")
+            opt.workload.scale = atof(v.c_str());
+        else if (a == "--seed")
+            opt.workload.seed = static_cast<uint32_t>(strtoul(v.c_str(), nullptr, 10));
+        else if (a == "--burn")
+            opt.workload.burn_path = v;
+        else if (a == "--policies")
+            opt.policies = split_list(v);
+        else if (a == "--quanta")
+        {
+            vector<string> q = split_list(v);
+            if (q.size() != 4)
+                return false;
+            for (int k = 0; k < 4; ++k)
+                opt.quanta[k] = atoi(q[k].c_str());
+        }
+        else if (a == "--trace")
+            opt.trace_path = v;
+        else if (a == "--out")
+            opt.out_path = v;
+        else
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions opt;
+    if (!parse_options(argc, argv, opt))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (access(opt.workload.burn_path.c_str(), X_OK) != 0)
+    {
+        cerr << "burn helper not found at " << opt.workload.burn_path << " (use --burn)\n";
+        return 1;
+    }
+
+    vector<WorkloadJob> workload = generate_workload(opt.workload);
+    if (!write_workload_trace(workload, opt.workload, opt.trace_path))
+        return 1;
+    if (opt.generate_only)
+        return 0;
+
+    vector<RunStats> runs;
+    for (const string &policy : opt.policies)
+    {
+        cerr << "Running " << policy << " on " << workload.size() << " jobs\n";
+        streambuf *saved = cout.rdbuf();
+        if (opt.quiet)
+            cout.rdbuf(nullptr);
+        if (policy == "fcfs" || policy == "rr" || policy == "mlfq")
+            runs.push_back(run_offline(policy, workload, opt));
+        else if (policy == "online_sjf" || policy == "online_mlfq")
+            runs.push_back(run_online(policy, opt));
+        else
+            cerr << "Unknown policy " << policy << "\n";
+        cout.rdbuf(saved);
+        cout.clear();
+    }
+
+    FILE *out = fopen(opt.out_path.c_str(), "w");
+    if (!out)
+    {
+        cerr << "Could not open file " << opt.out_path << "\n";
+        return 1;
+    }
+    write_results_json(out, opt, runs);
+    fclose(out);
+    write_results_json(stdout, opt, runs);
+    return 0;
+}
@@ -23,7 +23,39 @@ void reset_process_state(std::vector<Process> &processes) {
     }
 }
 
-int main() {
+// --replay <trace> [--speedup <x>] [--loop <n>] drives the online schedulers
+// from a recorded workload; --record <trace> saves stdin submissions to one.
+// --checkpoint <file> runs only the online MLFQ on stdin, under a supervisor
+// that restarts it from the checkpoint (kill -HUP the supervisor to upgrade).
+int main(int argc, char **argv) {
+    string replay_path, record_path, checkpoint_path;
+    double speedup = 1.0;
+    int loops = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string opt = argv[i];
+        if (opt == "--replay") replay_path = argv[i + 1];
+        else if (opt == "--record") record_path = argv[i + 1];
+        else if (opt == "--speedup") speedup = atof(argv[i + 1]);
+        else if (opt == "--loop") loops = atoi(argv[i + 1]);
+        else if (opt == "--checkpoint") checkpoint_path = argv[i + 1];
+        else { cerr << "Unknown option " << opt << "\n"; return 1; }
+    }
+
+    if (!checkpoint_path.empty()) {
+        if (!replay_path.empty() || !record_path.empty()) {
+            cerr << "--checkpoint takes submissions from stdin only\n";
+            return 1;
+        }
+        if (!getenv(SCHED_SUPERVISED_ENV))
+            return run_supervisor(argv, checkpoint_path);
+        OnlineScheduler scheduler;
+        if (!scheduler.EnableCheckpoint(checkpoint_path))
+            return 1;
+        scheduler.EnableAdaptiveQuanta();
+        scheduler.MultiLevelFeedbackQueue(500, 1000, 2000, 4000);
+        return 0;
+    }
+
     std::vector<Process> processes = {
         {"ls"},
         {"echo Hello"}
@@ -44,9 +76,31 @@ int main() {
     cout << "  sleep 1\n  echo Hello\n  ls -l\n";
     cout << "(Press Ctrl+D or close stdin to stop)\n\n";
 
-     OnlineScheduler scheduler;
-  //  Run the SJF algorithm with k = 3 (average of last 3 bursts)
-    scheduler.ShortestJobFirst(3);
+    // Each policy gets a fresh scheduler, so job ids, results and after:
+    // dependencies only ever refer to its own jobs.
+    {
+        OnlineScheduler scheduler;
+        if (!record_path.empty())
+            scheduler.RecordTrace(record_path);
+        if (!replay_path.empty() && !scheduler.ReplayTrace(replay_path, speedup, loops))
+            return 1;
+        //  Run the SJF algorithm with k = 3 (average of last 3 bursts)
+        scheduler.ShortestJobFirst(3);
+    }
+
+    // A replayed trace is fed again in full; a terminal can take more
+    // commands after Ctrl+D. Piped stdin is used up, so MLFQ would run nothing.
+    if (replay_path.empty() && !isatty(STDIN_FILENO))
+        return 0;
+    cout << "\n=== Online Multi-Level Feedback Queue (MLFQ) Test ===\n";
+    if (replay_path.empty())
+        cout << "Enter shell commands again (Ctrl+D to stop)\n\n";
+    OnlineScheduler scheduler;
+    if (!replay_path.empty() && !scheduler.ReplayTrace(replay_path, speedup, loops))
+        return 1;
+    // Starting quanta below are only the initial guess; MLFQ retunes them
+    // from the measured switch cost and burst history.
+    scheduler.EnableAdaptiveQuanta();
     scheduler.MultiLevelFeedbackQueue(500, 1000, 2000, 4000);
     
     return 0;
@@ -0,0 +1,126 @@
+#include "Shard_frontend.h"
+#include <vector>
+#include <string>
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+using namespace std;
+
+// Sharded front end: forks N OnlineScheduler shards, each pinned to a NUMA
+// node or CPU set, and routes commands from stdin (and optionally a trace)
+// to them by load and command affinity.
+//
+//   ./shard_main [--shards n] [--policy sjf|mlfq] [--cpus 0-3:4-7] [--replay trace]
+//                [--speedup x]
+int main(int argc, char **argv) {
+    ShardConfig cfg;
+    string replay_path;
+    double speedup = 1.0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string opt = argv[i], val = argv[i + 1];
+        if (opt == "--shards") cfg.shards = atoi(val.c_str());
+        else if (opt == "--policy") cfg.policy = (val == "sjf") ? SHARD_SJF : SHARD_MLFQ;
+        else if (opt == "--cpus") {
+            size_t start = 0, colon;
+            while ((colon = val.find(':', start)) != string::npos) {
+                cfg.cpu_lists.push_back(val.substr(start, colon - start));
+                start = colon + 1;
+            }
+            cfg.cpu_lists.push_back(val.substr(start));
+        }
+        else if (opt == "--replay") replay_path = val;
+        else if (opt == "--speedup") speedup = atof(val.c_str());
+        else { cerr << "Unknown option " << opt << "\n"; return 1; }
+    }
+
+    vector<Shard> shards;
+    if (!start_shards(cfg, shards))
+        return 1;
+
+    TraceReplay replay;
+    if (!replay_path.empty() && !open_trace(replay, replay_path, speedup, 1))
+        return 1;
+
+    set_program_start_time();
+    unordered_map<string, int> affinity;
+    vector<ShardPlacement> placed;
+    bool stdin_open = true;
+    string pending;
+    auto submit = [&](const string &line, double weight, uint32_t deadline_ms) {
+        submit_to_shards(shards, affinity, placed, line, weight, deadline_ms);
+    };
+
+    while (true) {
+        poll_trace(replay, now_ms(), [&](const TraceEntry &e, uint64_t) {
+            submit(string(e.cmd, e.cmd_len), e.weight, e.deadline_ms);
+        });
+        if (!stdin_open && replay.done)
+            close_shard_inputs(shards);
+
+        vector<pollfd> fds;
+        if (stdin_open)
+            fds.push_back({STDIN_FILENO, POLLIN, 0});
+        for (Shard &s : shards)
+            if (!s.closed)
+                fds.push_back({s.sock, static_cast<short>(POLLIN | (s.outbox.empty() ? 0 : POLLOUT)), 0});
+        if (fds.empty())
+            break;
+
+        int timeout = -1;
+        if (!replay.done) {
+            uint64_t now = now_ms();
+            uint64_t due = replay.start_ms == 0 ? now : trace_due_ms(replay);
+            timeout = static_cast<int>(due > now ? due - now : 0);
+        }
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR)
+            break;
+
+        for (const pollfd &p : fds) {
+            if (!(p.revents & (POLLIN | POLLOUT | POLLHUP | POLLERR)))
+                continue;
+            if (p.fd == STDIN_FILENO) {
+                char buf[8192];
+                ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+                if (n <= 0) {
+                    stdin_open = false;
+                    if (!pending.empty())
+                        submit(pending, 1.0, 0);
+                    continue;
+                }
+                pending.append(buf, static_cast<size_t>(n));
+                size_t start = 0, nl;
+                while ((nl = pending.find('\n', start)) != string::npos) {
+                    string line = pending.substr(start, nl - start);
+                    while (!line.empty() && line.back() == '\r')
+                        line.pop_back();
+                    if (!line.empty())
+                        submit(line, 1.0, 0);
+                    start = nl + 1;
+                }
+                pending.erase(0, start);
+                continue;
+            }
+            for (Shard &s : shards) {
+                if (s.sock != p.fd)
+                    continue;
+                if (p.revents & POLLOUT)
+                    flush_shard_outbox(s);
+                if ((p.revents & (POLLIN | POLLHUP | POLLERR)) && !read_completions(s)) {
+                    // Nothing routed to it from now on; queued input is lost with it.
+                    if (s.writable)
+                        cerr << "Shard (pid " << s.pid << ") closed its socket\n";
+                    s.closed = true;
+                    s.writable = false;
+                    s.outbox.clear();
+                }
+            }
+        }
+    }
+
+    wait_for_shards(shards);
+    string merged = string("result_sharded_") + shard_policy_name(cfg.policy) + ".csv";
+    merge_shard_results(shards, cfg.policy, merged);
+    print_shard_summary(shards);
+    cout << "Merged results written to " << merged << "\n";
+    return 0;
+}
@@ -0,0 +1,267 @@
+// Behavioural checks for the scheduler's pure helpers: command interning,
+// trace parsing and looping, the quantum controller, submission prefixes and
+// the checkpoint file layout. Run through ctest; exits non-zero on failure.
+#include "../Online_scheduler.h"
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                              \
+    do                                                                           \
+    {                                                                            \
+        if (!(cond))                                                             \
+        {                                                                        \
+            cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+            failures++;                                                          \
+        }                                                                        \
+    } while (0)
+
+static void test_command_arena()
+{
+    CommandArena a;
+    CHECK(a.find("ls", 2) == -1);
+    uint32_t ls = a.intern("ls");
+    uint32_t echo = a.intern("echo hi");
+    CHECK(ls == 0 && echo == 1);
+    CHECK(a.intern("ls", 2) == ls);
+    CHECK(a.find("echo hi", 7) == static_cast<int>(echo));
+    CHECK(a.find("echo", 4) == -1);
+    CHECK(string(a.c_str(echo)) == "echo hi" && a.length(echo) == 7);
+
+    // Ids stay dense and strings intact across rehashes.
+    for (int i = 0; i < 1000; ++i)
+        CHECK(a.intern("cmd " + to_string(i)) == static_cast<uint32_t>(i + 2));
+    CHECK(a.size() == 1002);
+    CHECK(string(a.c_str(ls)) == "ls");
+    CHECK(a.find("cmd 999", 7) == 1001 && a.length(1001) == 7);
+}
+
+static bool parse(const string &line, TraceEntry &e)
+{
+    return parse_trace_line(line.data(), line.data() + line.size(), e);
+}
+
+static void test_parse_trace_line()
+{
+    TraceEntry e;
+    string line = "100,2.5,500,echo a,b \r"; // e.cmd points into it
+    CHECK(parse(line, e));
+    CHECK(e.offset_ms == 100 && e.weight == 2.5 && e.deadline_ms == 500);
+    CHECK(string(e.cmd, e.cmd_len) == "echo a,b");
+
+    CHECK(parse("  7,0,0,ls", e));
+    CHECK(e.offset_ms == 7 && e.weight == 1.0 && e.deadline_ms == 0); // weight <= 0 means normal
+
+    CHECK(!parse("", e));
+    CHECK(!parse("# 0,1,0,ls", e));
+    CHECK(!parse("0,1,ls", e)); // missing field
+    CHECK(!parse("0,1,0,  ", e)); // no command
+}
+
+static TraceReplay trace_from(const string &text, int loops)
+{
+    TraceReplay r;
+    r.map = text.data();
+    r.map_len = text.size();
+    r.cursor = r.map;
+    r.loops = loops;
+    r.done = false;
+    return r;
+}
+
+static void test_advance_trace()
+{
+    string text = "# header\n0,1,0,a\n\n50,1,0,b";
+    TraceReplay r = trace_from(text, 2);
+    vector<uint64_t> at;
+    string cmds;
+    while (advance_trace(r))
+    {
+        at.push_back(r.loop_base_ms + r.pending.offset_ms);
+        cmds.append(r.pending.cmd, r.pending.cmd_len);
+    }
+    CHECK(cmds == "abab");
+    CHECK(at.size() == 4 && at[0] == 0 && at[1] == 50 && at[2] == 50 && at[3] == 100);
+    CHECK(r.done && !r.has_pending);
+
+    // Endless looping over a trace without entries must still terminate.
+    string empty = "# nothing\n\n";
+    TraceReplay e = trace_from(empty, 0);
+    CHECK(!advance_trace(e) && e.done);
+
+    // Loop 0 repeats forever.
+    TraceReplay f = trace_from(text, 0);
+    int n = 0;
+    while (n < 10 && advance_trace(f))
+        n++;
+    CHECK(n == 10 && !f.done);
+}
+
+static void test_tune_quanta()
+{
+    int q[3] = {100, 200, 400};
+    int boost = 1000;
+    QuantumTuner t;
+    vector<double> bursts(8, 10.0);
+    CHECK(!tune_quanta(t, bursts, q, boost, 1)); // disabled
+    t.enabled = true;
+    CHECK(!tune_quanta(t, bursts, q, boost, 2)); // no switch cost measured yet
+    CHECK(q[0] == 100 && q[1] == 200 && q[2] == 400 && boost == 1000);
+
+    // 1ms switches at a 2% overhead target need slices of at least 49ms;
+    // smoothing approaches that floor from above and never crosses it.
+    record_switch_cost(t, 1000);
+    for (int i = 0; i < 20; ++i)
+        tune_quanta(t, bursts, q, boost, 3 + i);
+    for (int i = 0; i < 3; ++i)
+        CHECK(q[i] >= 49 && q[i] <= 50);
+    CHECK(boost == t.bounds.min_boost_ms);
+
+    // Long bursts pull the quanta up towards their percentiles, in order.
+    vector<double> long_bursts;
+    for (int i = 1; i <= 100; ++i)
+        long_bursts.push_back(100.0 * i);
+    CHECK(tune_quanta(t, long_bursts, q, boost, 100));
+    CHECK(q[0] > 49 && q[0] <= q[1] && q[1] <= q[2]);
+    for (int i = 0; i < 30; ++i)
+        tune_quanta(t, long_bursts, q, boost, 101 + i);
+    CHECK(q[0] == 5100 && q[1] == t.bounds.max_quantum_ms && q[2] == t.bounds.max_quantum_ms);
+    CHECK(boost == t.bounds.max_boost_ms);
+}
+
+static JobHandle submit(JobTable &jobs, CommandArena &arena, vector<CmdHistory> &h, const string &line)
+{
+    return enqueue_command(jobs, arena, h, line.data(), line.size(), 0);
+}
+
+static void test_enqueue_command()
+{
+    JobTable jobs;
+    CommandArena arena;
+    vector<CmdHistory> hist;
+    JobHandle a = submit(jobs, arena, hist, "echo a");
+    CHECK(a == 0 && string(arena.c_str(jobs.history_index[a])) == "echo a");
+    CHECK(jobs.weight[a] == 1.0f && jobs.metrics[a].deadline_ms == 0);
+
+    JobHandle b = submit(jobs, arena, hist, "weight:2 deadline:300  after:0 echo b");
+    CHECK(b == 1 && string(arena.c_str(jobs.history_index[b])) == "echo b");
+    CHECK(jobs.weight[b] == 2.0f && jobs.metrics[b].deadline_ms == 300);
+    CHECK((jobs.state[b] & JOB_BLOCKED) && jobs.dag[b].pending == 1 && jobs.dag[a].children.size() == 1);
+
+    JobHandle c = submit(jobs, arena, hist, "after:-1,-2 echo a");
+    CHECK(c == 2 && jobs.history_index[c] == jobs.history_index[a]);
+    CHECK(jobs.dag[c].pending == 2);
+
+    // weight:0 keeps the default; prefixes with nothing after them are rejected.
+    JobHandle d = submit(jobs, arena, hist, "weight:0 ls");
+    CHECK(jobs.weight[d] == 1.0f);
+    CHECK(submit(jobs, arena, hist, "after:0") == NO_JOB);
+    CHECK(submit(jobs, arena, hist, "weight:3 ") == NO_JOB);
+    CHECK(jobs.size() == 4);
+}
+
+#define TEST_RECORD_SIZE 24
+
+static void test_checkpoint_layout()
+{
+    char path[] = "/tmp/scheduler_tests_ckpt_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd != -1);
+    if (fd == -1)
+        return;
+    close(fd);
+
+    CheckpointFile cf;
+    CHECK(open_checkpoint(cf, path));
+    CHECK(!checkpoint_valid(cf, TEST_RECORD_SIZE)); // empty file
+    CHECK(reserve_checkpoint(cf, 2, 2, 1, 16, TEST_RECORD_SIZE));
+    CHECK(checkpoint_valid(cf, TEST_RECORD_SIZE));
+    CHECK(!checkpoint_valid(cf, TEST_RECORD_SIZE + 8)); // written by another build
+
+    // Fill every section, then grow them all so each has to move.
+    CheckpointHeader *h = checkpoint_header(cf);
+    h->job_count = 2;
+    h->history_count = 2;
+    h->edge_count = 1;
+    h->arena_bytes = 4;
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        CheckpointJob &j = checkpoint_jobs(cf)[i];
+        j.pid = 100 + static_cast<int32_t>(i);
+        j.history_index = static_cast<int32_t>(i);
+        j.level = -1;
+        memset(checkpoint_histories(cf) + i * TEST_RECORD_SIZE, 'h' + i, TEST_RECORD_SIZE);
+    }
+    checkpoint_edges(cf)[0] = CheckpointEdge{0, 1};
+    memcpy(checkpoint_arena(cf), "a\0b\0", 4);
+    CHECK(checkpoint_records_invalid(cf) == nullptr);
+
+    uint64_t old_edges_off = h->edges_off;
+    CHECK(reserve_checkpoint(cf, 1000, 500, 300, 100000, TEST_RECORD_SIZE));
+    h = checkpoint_header(cf);
+    CHECK(checkpoint_valid(cf, TEST_RECORD_SIZE));
+    CHECK(h->job_capacity >= 1000 && h->history_capacity >= 500 && h->edge_capacity >= 300 &&
+          h->arena_capacity >= 100000);
+    CHECK(h->edges_off > old_edges_off);
+    CHECK(h->job_count == 2 && h->history_count == 2 && h->edge_count == 1 && h->arena_bytes == 4);
+    CHECK(checkpoint_jobs(cf)[0].pid == 100 && checkpoint_jobs(cf)[1].pid == 101);
+    CHECK(checkpoint_histories(cf)[0] == 'h' && checkpoint_histories(cf)[2 * TEST_RECORD_SIZE - 1] == 'i');
+    CHECK(checkpoint_histories(cf)[2 * TEST_RECORD_SIZE] == 0); // gap cleared
+    CHECK(checkpoint_edges(cf)[0].parent == 0 && checkpoint_edges(cf)[0].child == 1);
+    CHECK(checkpoint_edges(cf)[1].parent == 0 && checkpoint_edges(cf)[1].child == 0);
+    CHECK(memcmp(checkpoint_arena(cf), "a\0b\0", 4) == 0 && checkpoint_arena(cf)[4] == 0);
+    CHECK(checkpoint_records_invalid(cf) == nullptr);
+
+    // Records restore would trip over.
+    checkpoint_jobs(cf)[1].history_index = 2;
+    CHECK(checkpoint_records_invalid(cf) != nullptr);
+    checkpoint_jobs(cf)[1].history_index = 1;
+    checkpoint_jobs(cf)[1].level = 3;
+    CHECK(checkpoint_records_invalid(cf) != nullptr);
+    checkpoint_jobs(cf)[1].level = 2;
+    checkpoint_edges(cf)[0] = CheckpointEdge{1, 0};
+    CHECK(checkpoint_records_invalid(cf) != nullptr);
+    checkpoint_edges(cf)[0] = CheckpointEdge{0, 1};
+    h->arena_bytes = 2; // only one command string left
+    CHECK(checkpoint_records_invalid(cf) != nullptr);
+    h->arena_bytes = 4;
+    CHECK(checkpoint_records_invalid(cf) == nullptr);
+
+    // Geometry that does not add up.
+    h->job_count = h->job_capacity + 1;
+    CHECK(!checkpoint_valid(cf, TEST_RECORD_SIZE));
+    h->job_count = 2;
+    h->edges_off += 8;
+    CHECK(!checkpoint_valid(cf, TEST_RECORD_SIZE));
+    h->edges_off -= 8;
+    h->file_size = cf.size + 1;
+    CHECK(!checkpoint_valid(cf, TEST_RECORD_SIZE));
+    h->file_size = cf.size;
+    CHECK(checkpoint_valid(cf, TEST_RECORD_SIZE));
+
+    close_checkpoint(cf);
+    unlink(path);
+}
+
+int main()
+{
+    test_command_arena();
+    test_parse_trace_line();
+    test_advance_trace();
+    test_tune_quanta();
+    test_enqueue_command();
+    test_checkpoint_layout();
+    if (failures)
+    {
+        cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    cout << "All scheduler checks passed\n";
+    return 0;
+}